@@ -0,0 +1,32 @@
+/* Helpers shared by Walter benchmarks.
+
+Each benchmark is a regular Walter test program printing one line per
+measured value in stable, tab separated format:
+
+	NAME	VALUE	UNIT
+
+Values are throughput so higher is better.
+*/
+
+/* Return monotonic clock time in seconds. */
+double bench_now(void);
+
+/* Print NAME measurement of N operations done between START time
+ * and now as N per second in UNIT. */
+void bench_rate(char *name, double n, double start, char *unit);
+
+double
+bench_now(void)
+{
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void
+bench_rate(char *name, double n, double start, char *unit)
+{
+	printf("%s\t%.2f\t%s\n", name, n / (bench_now() - start), unit);
+	fflush(stdout);
+}
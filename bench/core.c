@@ -0,0 +1,75 @@
+/* Benchmark of Walter startup and assertions. */
+
+#include "../walter.h"
+#include "bench.h"
+
+TEST("startups/s, exec registering all tests without running them")
+{
+	char *argv[] = {"core", "-l", "0", 0};
+	int i, n=500, ws;
+	pid_t pid;
+	double start;
+	start = bench_now();
+	for (i=0; i<n; i++) {
+		if ((pid = fork()) == -1)
+			err(1, "fork");
+		if (pid == 0) {
+			execv("/proc/self/exe", argv);
+			_exit(127);
+		}
+		if (waitpid(pid, &ws, 0) == -1)
+			err(1, "waitpid");
+		if (!WIFEXITED(ws) || WEXITSTATUS(ws))
+			errx(1, "exec of %s failed", argv[0]);
+	}
+	bench_rate("startup", n, start, "startups/s");
+}
+
+TEST("assertions/s, passing OK()")
+{
+	volatile int pass = 1;
+	long i, n=200000000;
+	double start;
+	start = bench_now();
+	for (i=0; i<n; i++)
+		OK(pass);
+	bench_rate("asserts", n, start, "assertions/s");
+}
+
+TEST("GB/s compared by SAME() of equal buffers")
+{
+	size_t siz = 64 << 20;
+	int i, n=16;
+	char *a, *b;
+	double start;
+	if (!(a = malloc(siz)) || !(b = malloc(siz)))
+		err(1, "malloc");
+	for (i=0; i<(int)siz; i++)
+		a[i] = b[i] = i;
+	start = bench_now();
+	for (i=0; i<n; i++)
+		SAME(a, b, siz);
+	bench_rate("same", n*(siz/1e9), start, "GB/s");
+	free(a);
+	free(b);
+}
+
+TEST("GB/s compared by NEARF() of equal float arrays")
+{
+	size_t siz = 16 << 20;
+	int i, n=16;
+	float *a, *b;
+	double start;
+	a = malloc(siz * sizeof *a);
+	b = malloc(siz * sizeof *b);
+	if (!a || !b)
+		err(1, "malloc");
+	for (i=0; i<(int)siz; i++)
+		a[i] = b[i] = i;
+	start = bench_now();
+	for (i=0; i<n; i++)
+		NEARF(a, b, siz, 0.001, 0.001);
+	bench_rate("nearf", n*(2*siz*sizeof *a/1e9), start, "GB/s");
+	free(a);
+	free(b);
+}
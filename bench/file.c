@@ -0,0 +1,45 @@
+/* Benchmark of Walter file assertions. */
+
+#include "../walter.h"
+#include "bench.h"
+
+char path[] = "/tmp/walter.bench.XXXXXX";
+char copy[] = "/tmp/walter.bench.XXXXXX";
+size_t siz = 512 << 20;
+
+TEST("Create two files with the same content")
+{
+	char buf[1 << 16];
+	size_t i;
+	int fd, cp;
+	if ((fd = mkstemp(path)) == -1 || (cp = mkstemp(copy)) == -1)
+		err(1, "mkstemp");
+	for (i=0; i<sizeof buf; i++)
+		buf[i] = i;
+	for (i=0; i<siz; i+=sizeof buf)
+		if (write(fd, buf, sizeof buf) != sizeof buf ||
+		    write(cp, buf, sizeof buf) != sizeof buf)
+			err(1, "write");
+	close(fd);
+	close(cp);
+}
+
+TEST("GB/s compared by FILE_SAME() of equal files")
+{
+	double start = bench_now();
+	FILE_SAME(path, copy);
+	bench_rate("fsame", siz/1e9, start, "GB/s");
+}
+
+TEST("GB/s hashed by FILE_HASH()")
+{
+	double start = bench_now();
+	FILE_HASH(path, "5304a5458883af96");
+	bench_rate("fhash", siz/1e9, start, "GB/s");
+}
+
+TEST("Remove files")
+{
+	unlink(path);
+	unlink(copy);
+}
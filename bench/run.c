@@ -0,0 +1,43 @@
+/* Benchmark of Walter RUN() commands. */
+
+#include "../walter.h"
+#include "bench.h"
+
+TEST("RUNs/s, spawning one command after another")
+{
+	int i, n=500;
+	double start = bench_now();
+	for (i=0; i<n; i++)
+		RUN("true", 0, 0, 0, 0);
+	bench_rate("run", n, start, "RUNs/s");
+}
+
+TEST("RUNs/s, spawning commands in BATCH")
+{
+	int i, n=500;
+	double start = bench_now();
+	BATCH(WH_JOBS) {
+		for (i=0; i<n; i++)
+			RUN("true", 0, 0, 0, 0);
+	}
+	bench_rate("batch", n, start, "RUNs/s");
+}
+
+TEST("GB/s compared by RUN() passing IN file and checking OUT")
+{
+	char path[] = "/tmp/walter.bench.XXXXXX", buf[1 << 16];
+	int i, fd, n=2048;      /* 128 MiB */
+	double start;
+	if ((fd = mkstemp(path)) == -1)
+		err(1, "mkstemp");
+	for (i=0; i<(int)sizeof buf; i++)
+		buf[i] = i;
+	for (i=0; i<n; i++)
+		if (write(fd, buf, sizeof buf) != sizeof buf)
+			err(1, "write");
+	close(fd);
+	start = bench_now();
+	RUN("cat", path, path, 0, 0);
+	bench_rate("cmp", n*(sizeof buf/1e9), start, "GB/s");
+	unlink(path);
+}
@@ -0,0 +1,29 @@
+/* Concurrent stress tests with assertions from many threads. */
+
+#include "../walter.h"
+
+long counter = 0;               /* Shared between threads */
+long slots[4];                  /* One for each thread */
+
+TEST("Reset state")
+{
+	counter = 0;
+}
+
+STRESS("Atomic counter", 4, 100000)	/* Body runs on each thread */
+{
+	long old = __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+	OK(old >= 0 && old < 4 * 100000);
+	slots[WH_THREAD] = WH_ITER;	/* Thread index and iteration */
+}
+
+TEST("Counter was incremented by every thread")
+{
+	OK(counter == 4 * 100000);
+	OK(slots[0] == 99999 && slots[3] == 99999);
+}
+
+STRESS("Fail to demonstrate error message with thread index", 2, 10)
+{
+	ASSERT(WH_THREAD != 1 || WH_ITER != 5, "Fail at 6th iteration");
+}
@@ -0,0 +1,59 @@
+/* Capturing command results for custom assertions. */
+
+#include <ctype.h>
+#include "../walter.h"
+
+/* Return number of lines in N bytes of BUF. */
+int lines(char *buf, size_t n);
+
+int
+lines(char *buf, size_t n)
+{
+	int count=0;
+	while (n--)
+		count += *buf++ == '\n';
+	return count;
+}
+
+TEST("Outputs, exit code and resources usage of commands")
+{
+	WH_CAPTURE r;
+
+	CAPTURE("echo out; echo err >&2; exit 3", 0, &r);
+	SAME(r.out, "out\n", -1);
+	SAME(r.err, "err\n", -1);
+	OK(r.outn == 4 && r.errn == 4);
+	OK(r.code == 3 && r.sig == 0);
+
+	CAPTURE("tr a-z A-Z", STR"walter", &r);
+	SAME(r.out, "WALTER", -1);
+	OK(r.errn == 0);
+	OK(r.ru.ru_maxrss > 0);
+
+	CAPTURE("kill -9 $$", 0, &r);
+	OK(r.code == -1 && r.sig == 9);
+}
+
+TEST("Big outputs stay in arena until end of test")
+{
+	WH_CAPTURE a, b;
+	int i;
+
+	CAPTURE("seq 100000", 0, &a);
+	CAPTURE("seq 100000 >&2", 0, &b);
+	OK(lines(a.out, a.outn) == 100000);
+	SAME(a.out, b.err, a.outn);
+	SAME(a.out + a.outn - 7, "100000\n", -1);
+	for (i=0; i < 8; i++)
+		OK(isdigit(a.out[i*2]));
+}
+
+TEST("Fail to demonstrate custom assertions over captured output")
+{
+	WH_CAPTURE r;
+
+	CAPTURE("printf 'a\\nb\\nc\\n'", 0, &r);
+	OK(lines(r.out, r.outn) == 4);
+	SAME(r.out + 2, "c", 1);
+	CAPTURE("sleep 5", 0, &r);
+}
@@ -0,0 +1,75 @@
+/* Measuring time of nested regions of test. */
+
+#include "../walter.h"
+
+/* Sleep for MS milliseconds. */
+void nap(int ms);
+
+/* Count N in region left with return. */
+void count(int *n);
+
+void
+nap(int ms)
+{
+	struct timespec ts;
+	ts.tv_sec = 0;
+	ts.tv_nsec = ms * 1000000L;
+	nanosleep(&ts, 0);
+}
+
+void
+count(int *n)
+{
+	TIMED("count") {
+		(*n)++;
+		return;
+	}
+}
+
+TEST("Phases of import")
+{
+	int i;
+
+	TIMED("load") {
+		TIMED("open") nap(1);
+		TIMED("parse") {
+			nap(2);
+			OK(1);
+		}
+	}
+	for (i=0; i<3; i++)
+		TIMED("save") nap(1);
+}
+
+TEST("Test without regions prints nothing")
+{
+	OK(1);
+}
+
+TEST("Fail to demonstrate region closed at the end of test")
+{
+	TIMED("check") {
+		TIMED("early") {
+			ASSERT(0, "Leave with return");
+			return;
+		}
+	}
+}
+
+TEST("Break leaves region, return from function closes it later")
+{
+	int i, n=0;
+
+	for (i=0; i<3; i++)
+		TIMED("step") {
+			if (i == 0)
+				break;  /* Leaves only region */
+			n++;
+		}
+	OK(n == 2);
+	TIMED("after") {
+		count(&n);
+		TIMED("next") n++;
+	}
+	OK(n == 4);
+}
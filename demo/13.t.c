@@ -0,0 +1,13 @@
+/* BATCH with more commands than there are free file descriptors.
+ * Run with "ulimit -n 64" to see it. */
+
+#include "../walter.h"
+
+TEST("Files of done BATCH commands are closed before next ones")
+{
+	int i;
+	BATCH(8) {
+		for (i=0; i<600; i++)
+			RUN("cat", "snap/2a", "snap/2a", 0, 0);
+	}
+}
@@ -0,0 +1,23 @@
+/* Timeouts of commands that never exit or never close output. */
+
+#include "../walter.h"
+
+TEST("RUNT with commands finishing on time")
+{
+	RUNT("echo ok", 0, STR"ok\n", 0, 0, 1000);
+	RUNT("sleep 0.1; echo ok", 0, STR"ok\n", 0, 0, 1000);
+	RUNT("cat", STR"Walter", STR"Walter", 0, 0, 1000);
+}
+
+TEST("Fail to demonstrate timeout error messages")
+{
+	RUNT("sleep 5", 0, 0, 0, 0, 100);
+	RUNT("printf abc; sleep 5", 0, STR"abc", 0, 0, 100);
+	RUNT("echo err >&2; sleep 5 & wait", 0, 0, STR"err\n", 0, 100);
+	RUNT("trap '' TERM; printf abc; while :; do :; done", 0, 0, 0, 0, 100);
+}
+
+TEST("RUN with default timeout from -t option")
+{
+	RUN("sleep 5", 0, 0, 0, 0);
+}
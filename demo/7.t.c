@@ -0,0 +1,49 @@
+/* Running commands concurrently with BATCH. */
+
+#include "../walter.h"
+
+TEST("BATCH runs commands at once, takes as long as slowest")
+{
+	BATCH(4) {
+		RUN("sleep 0.2; echo 1", 0, STR"1\n", 0, 0);
+		RUN("sleep 0.2; echo 2", 0, STR"2\n", 0, 0);
+		RUN("sleep 0.2; echo 3", 0, STR"3\n", 0, 0);
+		RUN("sleep 0.2; echo 4", 0, STR"4\n", 0, 0);
+	}
+	RUNT("true", 0, 0, 0, 0, 1000);	/* After BATCH as usual */
+}
+
+TEST("Fail to demonstrate BATCH error messages")
+{
+	BATCH(2) {
+		RUN("tr abc 123", STR"AaBbCc", STR"A1B_C3", 0, 0);
+		RUN("echo ok", 0, STR"ok\n", 0, 0);
+		RUNT("sleep 5", 0, 0, 0, 0, 100);
+		RUN("ls /", 0, 0, 0, 1);
+	}
+	OK(1);
+}
+
+TEST("Fail to demonstrate BATCH left with break and return")
+{
+	BATCH(2) {
+		RUN("false", 0, 0, 0, 0);
+		break;
+	}
+	RUN("exit 2", 0, 0, 0, 0);      /* Runs at once, not queued */
+	BATCH(2) {
+		RUN("exit 3", 0, 0, 0, 0);
+		return;
+	}
+}
+
+TEST("IN files pass to commands, also to ones that stop reading")
+{
+	int i;
+	RUN("cat", "snap/2a", "snap/2a", 0, 0);
+	RUN("head -c 1", "walter.h", STR"/", 0, 0);
+	BATCH(2) {
+		for (i=0; i<3; i++)
+			RUN("head -c 1", "walter.h", STR"/", 0, 0);
+	}
+}
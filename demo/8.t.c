@@ -0,0 +1,52 @@
+/* Numeric arrays compared with tolerance. */
+
+#include "../walter.h"
+
+TEST("Arrays near each other")
+{
+	double  a[4] = {1.0, 2.0, 3.0, 1e9};
+	double  b[4] = {1.0, 2.0, 3.001, 1e9+1};
+	float  fa[3] = {0.1f, 0.2f, 0.3f};
+	float  fb[3] = {0.1f, 0.2f, 0.30000004f};
+	int    ia[5] = {0, -10, 20, 30, 40};
+	int    ib[5] = {1, -11, 20, 29, 40};
+	double inf[2];
+	float  finf[2];
+
+	inf[0] = 1.0 / 0.0;		/* Infinity */
+	inf[1] = 1.0;
+	finf[0] = -1.0f / 0.0f;
+	finf[1] = 1.0f;
+
+	NEAR(a, b, 3, 0.01, 0);		/* Absolute tolerance */
+	NEAR(a, b, 4, 0, 0.001);	/* Relative tolerance */
+	NEARF(fa, fb, 3, 1e-6, 0);
+	ULPF(fa, fb, 3, 1);		/* Units in the last place */
+	ULP(a, a, 4, 0);
+	NEARI(ia, ib, 5, 1);
+	NEAR(inf, inf, 2, 0.1, 0);	/* Same infinities */
+	NEARF(finf, finf, 2, 0.1, 0);
+	ULP(a, b, 4, -1);		/* Any distance but NaN */
+	ULPF(fa, fb, 3, -1);
+	NEARI(ia, ib, 5, -1);
+}
+
+TEST("Fail to demonstrate numeric array error messages")
+{
+	double  a[20], b[20];
+	float  fa[3] = {0.1f, 0.2f, 0.3f};
+	float  fb[3] = {0.1f, 0.2f, 0.30000004f};
+	int    ia[5] = {0, -10, 20, 30, 40};
+	int    ib[5] = {1, -11, 20, 29, 40};
+	int    i;
+
+	for (i=0; i<20; i++)
+		a[i] = b[i] = i / 4.0;
+	b[10] += 0.5;
+	b[12] += 0.25;
+	b[19] = 0.0 / 0.0;		/* NaN */
+
+	NEAR(a, b, 20, 0.1, 0);
+	ULPF(fa, fb, 3, 0);
+	NEARI(ia, ib, 5, 0);
+}
@@ -0,0 +1,41 @@
+/* Comparing and hashing files. */
+
+#include "../walter.h"
+
+/* Write 20 MiB file to PATH with byte at index BAD changed. */
+void big(char *path, long bad);
+
+void
+big(char *path, long bad)
+{
+	FILE *fp;
+	long i;
+	if (!(fp = fopen(path, "w")))
+		err(1, "fopen(%s)", path);
+	for (i=0; i < 20L<<20; i++)
+		putc(i == bad ? '!' : 'a' + i % 26, fp);
+	fclose(fp);
+}
+
+TEST("Files with the same content and hash")
+{
+	big("/tmp/walter.9a", -1);
+	big("/tmp/walter.9b", -1);
+
+	FILE_SAME("/tmp/walter.9a", "/tmp/walter.9b");
+	FILE_SAME("snap/empty", "snap/empty");
+	FILE_HASH("/tmp/walter.9a", "95013053ee7811fa");
+	FILE_HASH("snap/empty", "EF46DB3751D8E999");
+}
+
+TEST("Fail to demonstrate file error messages")
+{
+	big("/tmp/walter.9b", 15000001);
+
+	FILE_SAME("/tmp/walter.9a", "/tmp/walter.9b");
+	FILE_SAME("snap/empty", "demo/9.t.c");
+	FILE_SAME("snap/empty", "snap/missing");
+	FILE_HASH("/tmp/walter.9b", "95013053ee7811fa");
+	FILE_SAME("/tmp", "snap/empty");
+	FILE_HASH("/proc/self/status", "0");
+}
@@ -7,14 +7,54 @@ files using walter.h as they do.  What can go wrong (^_^ )
 
 TEST("Example demonstration tests should produce expected output")
 {
-	RUN("demo/0.t -h",   0, "snap/0a",    0, 1);
-	RUN("demo/0.t",      0, "snap/0b",    0, 3);
-	RUN("demo/0.t -q",   0, "snap/0c",    0, 3);
-	RUN("demo/0.t -l 1", 0, "snap/0d",    0, 1);
-	RUN("demo/1.t",      0, "snap/empty", 0, 0);
-	RUN("demo/2.t",      0, "snap/2a",    0, 5);
-	RUN("demo/2.t -q",   0, "snap/2b",    0, 5);
-	RUN("demo/3.t",      0, "snap/3a",    0, 3);
-	RUN("demo/4.t",      0, "snap/4a",    0, 1);
-	RUN("demo/5.t",      0, "snap/5a",    0, 1);
+	BATCH(8) {
+		RUN("demo/0.t -h",   0, "snap/0a",    0, 1);
+		RUN("demo/0.t",      0, "snap/0b",    0, 3);
+		RUN("demo/0.t -q",   0, "snap/0c",    0, 3);
+		RUN("demo/0.t -l 1", 0, "snap/0d",    0, 1);
+		RUN("demo/1.t",      0, "snap/empty", 0, 0);
+		RUN("demo/2.t",      0, "snap/2a",    0, 5);
+		RUN("demo/2.t -q",   0, "snap/2b",    0, 5);
+		RUN("demo/3.t",      0, "snap/3a",    0, 3);
+		RUN("demo/4.t",      0, "snap/4a",    0, 1);
+		RUN("demo/5.t",      0, "snap/5a",    0, 1);
+		RUN("demo/6.t -t 200", 0, "snap/6a",  0, 2);
+		RUN("demo/7.t",      0, "snap/7a",    0, 2);
+		RUN("demo/7.t -q",   0, "snap/7b",    0, 2);
+		RUN("demo/8.t",      0, "snap/8a",    0, 1);
+		RUN("demo/9.t",      0, "snap/9a",    0, 1);
+		RUN("demo/10.t",     0, 0,            0, 1);
+		RUN("demo/10.t | sed 's/[0-9]* ops\\/s/N ops\\/s/'",
+		    0, "snap/10a", 0, 0);
+		RUN("demo/11.t -t 200", 0, "snap/11a", 0, 1);
+		RUN("demo/12.t",     0, 0,            0, 1);
+		RUN("ulimit -n 64 && demo/13.t", 0, "snap/empty", 0, 0);
+	}
+}
+
+TEST("Test programs should run at once with -j option")
+{
+	RUN("demo/1.t -j 3 'demo/[13].t' @demo/list",
+	    0, "snap/1b", 0, 10);
+	RUN("demo/1.t -t 200 demo/6.t", 0, "snap/1c", 0, 1);
+}
+
+TEST("TIMED regions should be printed and saved with -p option")
+{
+	RUN("demo/12.t -p /tmp/walter.folded"
+	    " | sed 's/[0-9.]* ms/N ms/; s/[0-9]*%/N%/'",
+	    0, "snap/12a", 0, 0);
+	RUN("sed 's/ [0-9]*$/ N/' /tmp/walter.folded", 0, "snap/12b", 0, 0);
+}
+
+TEST("Stdout of RUN commands should be saved with -o option")
+{
+	RUN("mkdir -p /tmp/walter.o && demo/7.t -o /tmp/walter.o",
+	    0, "snap/7a", 0, 2);
+	RUN("cat /tmp/walter.o/7.t.c.8.out",  0, STR"1\n",     0, 0);
+	RUN("cat /tmp/walter.o/7.t.c.19.out", 0, STR"A1B2C3", 0, 0);
+	RUN("cat /tmp/walter.o/7.t.c.21.out", 0, STR"",       0, 0);
+	RUN("cat /tmp/walter.o/7.t.c.47.out",   0, STR"/", 0, 0);
+	RUN("cat /tmp/walter.o/7.t.c.47.3.out", 0, STR"/", 0, 0);
+	RUN("test -e /tmp/walter.o/7.t.c.47.4.out", 0, 0, 0, 1);
 }
@@ -1,4 +1,4 @@
-/* walter.h v5.0 from https://github.com/ir33k/walter by irek@gabr.pl
+/* walter.h v5.1 from https://github.com/ir33k/walter by irek@gabr.pl
 
 Walter is a single header library for writing unit tests in C made
 with fewer complications by avoiding boilerplate.
@@ -22,11 +22,20 @@ EXAMPLE
 	    SAME(s1, s2, -1);           // Are strings the same?
 	    DIFF(b1, b2, size);         // Are buffers different?
 	    DIFF(s1, s2, -1);           // Are strings different?
+	    NEAR(d1, d2, n, abs, rel);  // Are double arrays near?
+	    NEARF(f1, f2, n, abs, rel); // Are float arrays near?
+	    NEARI(i1, i2, n, abs);      // Are int arrays near?
+	    ULP(d1, d2, n, ulps);       // Are doubles max ulps apart?
+	    ULPF(f1, f2, n, ulps);      // Are floats max ulps apart?
+	    FILE_SAME(p1, p2);          // Are files the same?
+	    FILE_HASH(p1, hex);         // Is file XXH64 based hash?
 	    return;                     // Force end of test
 
 	    // Run CMD with std IN expecting std OUT, std ERR and exit
 	    // CODE.  Ignore IN, OUT or ERR by passing NULL.  To pass
 	    // string literals instead of file paths use STR prefix.
+	    // With -o DIR option stdout is also saved to DIR/F.L.out
+	    // file where F is test file name and L is RUN line.
 	    //
 	    //  CMD           IN         OUT         ERR         CODE
 	    RUN("grep wh_",   "in.txt",  "out.txt",  "err.txt",  0);
@@ -35,6 +44,36 @@ EXAMPLE
 	    RUN("ls -lh",     NULL,      "out.txt",  NULL,       0);
 	    RUN("pwd",        0,         0,          0,          0);
 	    RUN("tr ab AB",   STR"ab",   STR"AB",    0,          0);
+
+	    // Same as RUN but kill CMD process group with SIGTERM,
+	    // then SIGKILL, when it runs longer than MS milliseconds.
+	    // RUN uses timeout from -t option, no timeout by default.
+	    //
+	    //   CMD          IN    OUT        ERR  CODE  MS
+	    RUNT("sleep 9",   0,    0,         0,   0,    100);
+	    RUNT("./srv",     0,    "out.txt", 0,   0,    5000);
+
+	    // Run CMD with std IN and store its results in R of
+	    // WH_CAPTURE type.  Fails only on -t timeout.  Outputs
+	    // are null terminated and valid until end of test.
+	    //
+	    //      CMD          IN       R
+	    CAPTURE("ls -l",     0,       &r);
+	    SAME(r.out, "total", 5);    // Also r.err, r.outn, r.errn
+	    OK(r.code == 0);            // Exit code, -1 on signal
+	    OK(r.ru.ru_maxrss < 4096);  // Resources usage, r.sig
+
+	    // Run all RUN and RUNT commands of block at once, up to
+	    // MAX at the same time.  Failures are reported after the
+	    // block, each at line of its RUN.  Arguments have to stay
+	    // valid until end of block.  With -q test ends after block
+	    // with failure.  Break ends block, return ends test, in
+	    // both cases queued commands are run and reported.
+	    //
+	    BATCH(8) {
+	        RUN("./a.t",  0,    "a.out",   0,   0);
+	        RUN("./b.t",  0,    "b.out",   0,   0);
+	    }
 	}
 	TEST("Test 1") {...}            // Define as many as WH_MAX
 	SKIP("Test 2") {...}            // Skip or just ignore test
@@ -42,12 +81,42 @@ EXAMPLE
 	SKIP("TODO Test 4") {}          // Can be used for TODOs
 	ONLY("Test 5") {...}            // Ignore all other tests
 
+	// Run body ITERATIONS times on each of N threads pinned to
+	// CPUs and started at once.  Assertions can be used from any
+	// thread.  Failures print thread index, throughput in ops/s
+	// is always printed on line starting with #.
+	//
+	//     DESC     N  ITERATIONS
+	STRESS("Queue", 4, 1000000) {
+	    push(&q, WH_THREAD);        // Thread index from 0 to N-1
+	    OK(pop(&q) != -1);          // WH_ITER is iteration index
+	}
+
+	// Measure time of nested regions of test.  After test each
+	// region prints # line with total time, number of runs and
+	// percent of test time.  With -p FILE regions are also
+	// written to FILE as folded stacks of self time in
+	// microseconds, readable by flamegraph tools.  Break and
+	// continue leave region.
+	// Define WH_NO_TIMED to turn them into plain blocks.
+	//
+	TEST("Import") {
+	    TIMED("load") {             // Region with name
+	        TIMED("parse") {...}    // Nested region
+	    }
+	    for (i=0; i<n; i++)
+	        TIMED("save") {...}     // Runs are summed
+	}
+
 	// There is no main() function
 
 	$ cc test.c             # Compile
 	$ ./a.out -h            # Print help
 	$ ./a.out               # Run tests
 	$ echo $?               # Number of failed tests
+	$ ./a.out -j 8 '*.t'    # Run other test programs at once
+	$ ./a.out @list         # Same with patterns in list file
+	$ ./a.out -p out.folded # Write TIMED regions to file
 
 DISCLAIMERS
 	1. Library can be included only once because it has global
@@ -59,15 +128,45 @@ DISCLAIMERS
 	4. When buffer or string assertion fails Walter prints small
 	   part of arguments as preview.  If you need different length
 	   of that preview then modify WH_SHOW value.
-	5. I encourage you to modify source code.  If some macro name
+	5. BATCH() runs up to WH_JOBS commands at once.
+	6. I encourage you to modify source code.  If some macro name
 	   is in conflict to your existing macro then rename it.  If
 	   you need custom assert macro, then add it.  Source code is
 	   short and easy to change.
-	6. WH_ prefix stands for Walter.H.  _WH_ is for private stuff.
+	7. Walter needs POSIX and BSD wait4().  Linux extensions like
+	   splice() and pidfd are used when walter.h is included
+	   before other headers or with -D_GNU_SOURCE.  Link with
+	   -pthread on older systems.
+	8. Failed FILE_HASH prints actual hash that can be copied to
+	   test.
+	9. TIMED() regions can't be used in STRESS() body.  Region
+	   left with return is closed when next region starts in
+	   calling function, or at the latest with enclosing region
+	   or test.  Don't leave it with goto or longjmp.  There can
+	   be WH_REGIONS different regions per test.
+	10. WH_ prefix stands for Walter.H.  _WH_ is for private stuff.
 	   __WH_ is for super epic internal private stuff, just move
 	   along, this is not the code you are looking for  \(-_- )
 
 CHANGELOG
+	2026.10.18	v5.1
+
+	1. Add RUNT() assertion and -t option for RUN() timeouts.
+	2. Run RUN() command in own process group, kill it on timeout.
+	3. Pass stdin and read stdout and stderr of RUN() at once.
+	4. Report exit code of RUN() also when output is incorrect.
+	5. Use STR literals directly instead of /tmp/walter file.
+	6. Add BATCH() block running RUN() commands concurrently.
+	7. Pass IN file of RUN() with splice() when possible.
+	8. Add -o option saving RUN() stdout to files with tee().
+	9. Add bench/ programs measuring overhead of walter.h.
+	10. Add NEAR, NEARF, NEARI, ULP and ULPF array assertions.
+	11. Add FILE_SAME and FILE_HASH assertions using all CPUs.
+	12. Make assertions thread safe, add STRESS() test.
+	13. Run test programs given as arguments at once with -j.
+	14. Add CAPTURE() of command results into per test arena.
+	15. Add TIMED() regions and -p option for folded stacks.
+
 	2025.01.26	v5.0
 
 	1. Remove EQ, NEQ, SEQ and SNEQ assertions.
@@ -116,20 +215,54 @@ CHANGELOG
 #endif
 #define _WALTER_H
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             /* Linux extensions if included first */
+#endif
+
 #include <assert.h>
+#include <ctype.h>
 #include <err.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <glob.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
+#ifndef _POSIX_C_SOURCE
+int kill(pid_t pid, int sig);   /* Hidden by strict ISO C headers */
+#endif
+#ifndef WCOREFLAG
+pid_t wait4(pid_t pid, int *ws, int opt, struct rusage *ru); /* BSD */
+#endif
+
 #define WH_MAX	256             /* Maximum number of tests */
 #define WH_SHOW 32              /* How many chars print on error */
+#define WH_KILL 1000            /* Ms from SIGTERM to SIGKILL */
+#define WH_JOBS 64              /* Max concurrent BATCH() commands */
 #define STR     "\0"            /* 1 char prefix for RUN() args */
+#define WH_REGIONS 256          /* Max TIMED() regions in test */
+#define _WH_PART (1 << 20)      /* FILE_ assertions unit of work */
+
+#ifdef O_CLOEXEC
+#define _WH_CLOEXEC O_CLOEXEC   /* Else only set later with fcntl() */
+#else
+#define _WH_CLOEXEC 0
+#endif
 
 #define __WH_TEST(Desc, Id, Line)                                    \
 	void __wh_body##Id();                                        \
@@ -150,10 +283,24 @@ CHANGELOG
 #define SKIP(desc) _WH_TEST("SKIP "desc, __LINE__)
 #define ONLY(desc) _WH_TEST("ONLY "desc, __LINE__)
 
+#define __WH_STRESS(Desc, Threads, Iters, Id)                        \
+	void __wh_iter##Id();                                        \
+	__WH_TEST(Desc, Id, Id) {                                    \
+		_wh_stress(&__wh_iter##Id, Threads, Iters, Id);      \
+	}                                                            \
+	void __wh_iter##Id()
+#define _WH_STRESS(desc, threads, iters, id)                         \
+	__WH_STRESS(desc, threads, iters, id)
+
+#define STRESS(desc, threads, iters)                                 \
+	_WH_STRESS("TEST "desc, threads, iters, __LINE__)
+
+#define WH_THREAD _wh_tid       /* STRESS() thread index */
+#define WH_ITER   _wh_iter      /* STRESS() iteration of thread */
+
 #define _WH_ASSERT(bool, msg, line) do {                             \
 		if ((bool)) break;              /* Pass */           \
-		_wh_mistake++;                  /* Fail */           \
-		printf("%s:%d:\t%s\n", _wh_file, line, msg);         \
+		_wh_fail(line, msg);            /* Fail */           \
 		if (_wh_quick) return;          /* End quick */      \
 	} while(0)
 
@@ -168,26 +315,309 @@ CHANGELOG
 	ASSERT(_wh_eq(0, a, b, (size_t)n, (size_t)n),                \
 	       "DIFF("#a", "#b", "#n")")
 
+#define NEAR(a, b, n, abs, rel)                                      \
+	ASSERT(_wh_near(a, b, (size_t)n, abs, rel),                  \
+	       "NEAR("#a", "#b", "#n", "#abs", "#rel")")
+
+#define NEARF(a, b, n, abs, rel)                                     \
+	ASSERT(_wh_nearf(a, b, (size_t)n, abs, rel),                 \
+	       "NEARF("#a", "#b", "#n", "#abs", "#rel")")
+
+#define NEARI(a, b, n, abs)                                          \
+	ASSERT(_wh_neari(a, b, (size_t)n, abs),                      \
+	       "NEARI("#a", "#b", "#n", "#abs")")
+
+#define ULP(a, b, n, ulps)                                           \
+	ASSERT(_wh_ulp(a, b, (size_t)n, ulps),                       \
+	       "ULP("#a", "#b", "#n", "#ulps")")
+
+#define ULPF(a, b, n, ulps)                                          \
+	ASSERT(_wh_ulpf(a, b, (size_t)n, ulps),                      \
+	       "ULPF("#a", "#b", "#n", "#ulps")")
+
+#define FILE_SAME(a, b)                                              \
+	ASSERT(_wh_fsame(a, b), "FILE_SAME("#a", "#b")")
+
+#define FILE_HASH(path, hex)                                         \
+	ASSERT(_wh_fhash(path, hex), "FILE_HASH("#path", "#hex")")
+
+/* Compare numeric arrays A and B of N elements by calling AT with
+ * ARGS in parentheses on each 16 bytes block I.  AT returns mask of
+ * incorrect elements of type VM with K lanes and sets errors of
+ * elements in E vector of VE type.  Return from function with 1
+ * when all elements are correct, otherwise print details and
+ * return 0. */
+#define _WH_NEAR(at, args, VM, VE, K, digits, unit) do {             \
+	struct _wh_near r;                                           \
+	double wa[WH_SHOW/4], wb[WH_SHOW/4];                         \
+	VM g, any = {0};                                             \
+	VE e;                                                        \
+	size_t i, j;                                                 \
+	for (i=0; i<n; i+=K) {          /* Fast pass */              \
+		g = at args;                                         \
+		any |= g;                                            \
+	}                                                            \
+	for (j=0; j<K && !any[j]; j++);                              \
+	if (j == K)                                                  \
+		return 1;                                            \
+	memset(&r, 0, sizeof r);                                     \
+	for (i=0; i<n; i+=K) {          /* Find details */           \
+		g = at args;                                         \
+		for (j=0; j<K && i+j<n; j++) {                       \
+			if (g[j] && !r.bad++)                        \
+				r.first = i+j;                       \
+			if (r.max == r.max &&                        \
+			    (e[j] > r.max || e[j] != e[j])) {        \
+				r.max = e[j];                        \
+				r.worst = i+j;                       \
+			}                                            \
+		}                                                    \
+	}                                                            \
+	i = r.first - r.first % (WH_SHOW/4);                         \
+	for (j=0; j < WH_SHOW/4 && i+j < n; j++) {                   \
+		wa[j] = a[i+j];                                      \
+		wb[j] = b[i+j];                                      \
+	}                                                            \
+	return _wh_near_show(&r, n, wa, wb, j, digits, unit);        \
+} while (0)
+
+/* Load I block of A and B arrays with N elements to VA and VB
+ * vectors, padding past the end with zeros. */
+#define _WH_LOAD(va, vb, a, b, n, i) do {                            \
+	if (i + sizeof va / sizeof *a <= n) {                        \
+		memcpy(&va, a+i, sizeof va);                         \
+		memcpy(&vb, b+i, sizeof vb);                         \
+	} else {                                                     \
+		memset(&va, 0, sizeof va);                           \
+		memset(&vb, 0, sizeof vb);                           \
+		memcpy(&va, a+i, (n-i) * sizeof *a);                 \
+		memcpy(&vb, b+i, (n-i) * sizeof *b);                 \
+	}                                                            \
+} while (0)
+
+#define _WH_RUN(cmd, in, out, err, code, ms, msg)                    \
+	ASSERT(_wh_run(cmd, in, out, err, code, ms, __LINE__, msg), msg)
+
 #define RUN(cmd, in, out, err, code)                                 \
-	ASSERT(_wh_run(cmd, in, out, err, code),                     \
-	       "RUN("#cmd", "#in", "#out", "#err", "#code")")
+	_WH_RUN(cmd, in, out, err, code, _wh_timeout,                \
+		"RUN("#cmd", "#in", "#out", "#err", "#code")")
+
+#define RUNT(cmd, in, out, err, code, ms)                            \
+	_WH_RUN(cmd, in, out, err, code, ms,                         \
+		"RUNT("#cmd", "#in", "#out", "#err", "#code", "#ms")")
+
+#define CAPTURE(cmd, in, res)                                        \
+	ASSERT(_wh_capture(cmd, in, _wh_timeout, __LINE__, res),     \
+	       "CAPTURE("#cmd", "#in", "#res")")
+
+/* Inner loop catches break in BATCH() body so _wh_more() always
+ * runs queued commands.  Outer loop body ends test in quick mode. */
+#define BATCH(max)                                                   \
+	for (_wh_open(max); _wh_more(); )                            \
+		if (!_wh_batch) return;                              \
+		else for (; _wh_stage == 1; _wh_stage = 2)
+
+/* Inner loop catches break in TIMED() body so _wh_timed() always
+ * closes region.  Without timing it's one-shot loop as well so
+ * break has the same meaning in both cases.  Its flag is thread
+ * local and each loop reads it right after setting it, so nested
+ * regions and threads don't disturb each other. */
+#ifdef WH_NO_TIMED
+#define TIMED(name) for (_wh_once = 1; _wh_once; _wh_once = 0)
+#else
+#define TIMED(name)                                                  \
+	for (_wh_enter(name, __LINE__, __builtin_frame_address(0));  \
+	     _wh_timed(name, __builtin_frame_address(0)); )          \
+		for (; _wh_region[_wh_top].body == 1;                \
+		     _wh_region[_wh_top].body = 2)
+#endif
 
 char *_wh_help =
-"usage: %s [options]\n"
+"usage: %s [options] [program...]\n"
+"\n"
+"Without arguments run own tests.  Otherwise run test programs\n"
+"given as glob patterns or as @FILE with pattern per line.\n"
 "\n"
 "options:\n"
 "	-q	Quick, stop TEST on first failed assertion.\n"
 "	-l N	Limit, stop after N number of failed tests.\n"
+"	-t MS	Timeout, kill RUN commands and programs after MS ms.\n"
+"	-o DIR	Output, save stdout of RUN commands in DIR.\n"
+"	-j N	Jobs, run up to N test programs at once.\n"
+"	-p FILE	Profile, write TIMED regions as folded stacks.\n"
 "	-h	Prints this help message.\n";
 
+/* 16 bytes vectors for numeric array assertions. */
+typedef float    _wh_v4f __attribute__ ((vector_size (16)));
+typedef int32_t  _wh_v4i __attribute__ ((vector_size (16)));
+typedef uint32_t _wh_v4u __attribute__ ((vector_size (16)));
+typedef double   _wh_v2d __attribute__ ((vector_size (16)));
+typedef int64_t  _wh_v2l __attribute__ ((vector_size (16)));
+typedef uint64_t _wh_v2u __attribute__ ((vector_size (16)));
+
+/* Details of failed numeric array assertion. */
+struct _wh_near {
+	size_t  first;          /* Index of first incorrect element */
+	size_t  bad;            /* Number of incorrect elements */
+	size_t  worst;          /* Index of element with max error */
+	double  max;            /* Max error */
+};
+
+/* Range of mapped files compared or hashed by single thread. */
+struct _wh_part {
+	pthread_t  th;
+	char      *a, *b;       /* Mapped files, B is NULL for hash */
+	size_t     from, to;    /* Range of bytes */
+	size_t    *bad;         /* First incorrect byte of all parts */
+	uint64_t  *hash;        /* Hashes of each _WH_PART of A */
+};
+
+/* Start gate of STRESS() threads, pthread barriers are optional. */
+struct _wh_gate {
+	pthread_mutex_t lock;
+	pthread_cond_t  open;
+	int             wait;   /* Threads that are not ready yet */
+};
+
+/* Thread of STRESS() test. */
+struct _wh_thread {
+	pthread_t  th;
+	int        tid;         /* Thread index */
+	long       iters;       /* Iterations to run, then done */
+	uint64_t   from, to;    /* Start and end time in ns */
+	void     (*fn)();       /* STRESS() body */
+	struct _wh_gate *start; /* Released when all are ready */
+};
+
+/* Standard input, output or error stream of RUN() command. */
+struct _wh_io {
+	int     fd;             /* Parent end of pipe, -1 when closed */
+	int     src;            /* IN, OUT or ERR file, -1 when none */
+	char   *path;           /* Path to SRC file */
+	char   *str;            /* STR literal used instead of SRC */
+	size_t  len;            /* Remaining length of STR */
+	size_t  n;              /* Number of bytes passed through FD */
+	int     bad;            /* Non 0 when output is incorrect */
+	size_t  at;             /* Index of first incorrect byte */
+	int     an, bn, tn;     /* Lengths of A, B and TAIL */
+	char    a[WH_SHOW];     /* Preview of incorrect output */
+	char    b[WH_SHOW];     /* Preview of expected output */
+	char    tail[WH_SHOW];  /* Last bytes passed through FD */
+	int     copy;           /* Non 0 when splice() can't be used */
+	int     save;           /* Output copy file for -o, -1 none */
+	int     dup[2];         /* Pipe for tee() of FD into SAVE */
+	size_t  teed;           /* Bytes of FD already in SAVE */
+	int     keep;           /* Non 0 to capture output in BUF */
+	char   *buf;            /* Captured N bytes of output in arena */
+	size_t  cap;            /* Capacity of BUF */
+};
+
+/* Child process of RUN() command. */
+struct _wh_proc {
+	pid_t   pid;            /* Child process and its group id */
+	int     alive;          /* Non 0 until child is waited for */
+	int     pidfd;          /* Pollable child process or -1 */
+	int     ws;             /* Child wait status */
+	int     code;           /* Expected exit code */
+	int     ms;             /* Timeout in milliseconds, 0 none */
+	long    end;            /* Deadline in _wh_ms() time, 0 none */
+	int     sig;            /* Last signal sent on timeout or 0 */
+	struct rusage ru;       /* Child resources usage */
+	struct _wh_io io[3];    /* Child stdin, stdout and stderr */
+	size_t  off, len;       /* Pending BUF range for stdin */
+	char    buf[BUFSIZ];    /* Pending data for stdin */
+};
+
+/* RUN() command, also queued in BATCH(), or test program. */
+struct _wh_job {
+	char   *cmd, *in, *out, *err;
+	int     code, ms;
+	int     line;           /* Line of RUN() in test file */
+	char   *msg;            /* RUN() assertion message */
+	int     keep;           /* Capture stdout and stderr */
+	int     prog;           /* CMD is program path run without
+	                         * shell, with stderr in stdout */
+	int     none;           /* Program not found, not started */
+};
+
+/* Totals of test programs run by _wh_drive(). */
+struct _wh_total {
+	int     fail;           /* Sum of exit codes */
+	int     bad;            /* Programs that failed */
+	int     none;           /* Programs not found */
+};
+
+/* Block of per test arena. */
+struct _wh_arena {
+	struct _wh_arena *next; /* Previous block */
+	size_t  size, used;     /* Bytes of MEM */
+	char   *mem;            /* Memory right after this struct */
+};
+
+/* TIMED() region, node of test regions tree. */
+struct _wh_region {
+	char     *name;
+	int       line;         /* Line of first TIMED() */
+	int       parent;       /* Index of parent region, -1 none */
+	int       body;         /* 1 while body runs, 2 after */
+	char     *frame;        /* Stack frame of function with region */
+	long      count;        /* Number of finished runs */
+	uint64_t  start;        /* Time of current run start in ns */
+	uint64_t  ns;           /* Time of finished runs */
+};
+
+/* Results of CAPTURE(), valid until end of test. */
+typedef struct {
+	char   *out, *err;      /* Null terminated stdout and stderr */
+	size_t  outn, errn;     /* Lengths of OUT and ERR */
+	int     code;           /* Exit code, -1 when killed by signal */
+	int     sig;            /* Signal that killed process or 0 */
+	struct rusage ru;       /* Resources used by process */
+} WH_CAPTURE;
+
 char  *_wh_file=0;              /* Path to test file */
 int    _wh_quick=0;             /* True for -q option */
+int    _wh_timeout=0;           /* RUN() timeout from -t option */
+char  *_wh_dir=0;               /* RUN() stdout directory, -o option */
 int    _wh_all=0;               /* Number of all tests */
 int    _wh_only=0;              /* Non 0 when ONLY() macro was used */
 int    _wh_mistake;             /* Number of failed assertions in test */
+__thread int  _wh_tid=-1;       /* STRESS() thread index, -1 outside */
+__thread long _wh_iter=0;       /* STRESS() iteration of thread */
+__thread int  _wh_once=0;       /* TIMED() loop with WH_NO_TIMED */
 char  *_wh_desc[WH_MAX];        /* TEST() type + description */
 int    _wh_line[WH_MAX];        /* TEST() line number in file */
 void (*_wh_func[WH_MAX])();     /* TEST() functions pointers */
+int    _wh_batch=0;             /* BATCH() max concurrent commands */
+int    _wh_stage=0;             /* BATCH() 0 before body, 1 in, 2 after */
+int    _wh_jobs=0;              /* Number of commands in BATCH() */
+int    _wh_jobs_max=0;          /* Capacity of _wh_job */
+struct _wh_job *_wh_job=0;      /* Commands queued in BATCH() */
+struct _wh_arena *_wh_arena=0;  /* Newest block of test arena */
+pthread_mutex_t _wh_lock = PTHREAD_MUTEX_INITIALIZER; /* Of globals */
+int    _wh_blocked=0;           /* RUN() calls with SIGPIPE ignored */
+void (*_wh_sigpipe)(int);       /* SIGPIPE handler before them */
+struct _wh_region _wh_region[WH_REGIONS]; /* TIMED() of test */
+int    _wh_regions=0;           /* Number of regions in test */
+int    _wh_top=-1;              /* Innermost open region, -1 none */
+char   _wh_empty[1];            /* Mapping of empty file */
+int   *_wh_saved=0;             /* -o files of each RUN() line */
+int    _wh_saved_max=0;         /* Capacity of _wh_saved */
+FILE  *_wh_prof=0;              /* Folded stacks file, -p option */
+
+/* Count failed assertion at LINE and print its MSG with thread
+ * index when called from STRESS() thread. */
+void _wh_fail(int line, char *msg);
+
+/* Run FN body ITERS times on each of N threads pinned to CPUs and
+ * started at once.  Print throughput of STRESS() from LINE. */
+void _wh_stress(void (*fn)(), int n, long iters, int line);
+
+/* STRESS() thread function running ARG _wh_thread. */
+void *_wh_stress_thread(void *arg);
+
+/* Wait until all threads of G gate are ready. */
+void _wh_ready(struct _wh_gate *g);
 
 /* Compare buffer A of size N with buffer B of size M.  When N is -1
  * then it's assumed that A is null terminated string, same for B and
@@ -195,37 +625,272 @@ void (*_wh_func[WH_MAX])();     /* TEST() functions pointers */
  * or when EQ value is 0 and buffers are different. */
 int _wh_eq(int eq, char *a, char *b, size_t n, size_t m);
 
-/* Compare A file content with SRC being either literal string when
- * prefixed with STR or file path.  Return non 0 when different. */
-int _wh_fdcmp(int a, char *src);
+/* Print first incorrect byte at index I with A of N length and B
+ * of M length previews. */
+void _wh_show(size_t i, char *a, int n, char *b, int m);
+
+/* Return non 0 when each element of A and B double arrays of N size
+ * differs by at most X or by at most Y times bigger of the two
+ * absolute values.  NaN is never near anything. */
+int _wh_near(double *a, double *b, size_t n, double x, double y);
+
+/* Same as _wh_near() but for float arrays. */
+int _wh_nearf(float *a, float *b, size_t n, double x, double y);
+
+/* Return non 0 when each element of A and B int arrays of N size
+ * differs by at most TOL. */
+int _wh_neari(int *a, int *b, size_t n, unsigned tol);
+
+/* Return non 0 when each element of A and B double arrays of N size
+ * is at most ULPS representable values away from each other. */
+int _wh_ulp(double *a, double *b, size_t n, unsigned long ulps);
+
+/* Same as _wh_ulp() but for float arrays. */
+int _wh_ulpf(float *a, float *b, size_t n, unsigned long ulps);
+
+/* Vector kernels of above functions.  Compare I block of A and B
+ * arrays of N size with X and Y tolerance, or TOL integer one.  Set
+ * errors in E and return mask of incorrect elements. */
+_wh_v2l _wh_near_at(double *a, double *b, size_t n, size_t i,
+		    double x, double y, _wh_v2d *e);
+_wh_v4i _wh_nearf_at(float *a, float *b, size_t n, size_t i,
+		     double x, double y, _wh_v4f *e);
+_wh_v4i _wh_neari_at(int *a, int *b, size_t n, size_t i,
+		     uint32_t tol, _wh_v4u *e);
+_wh_v2l _wh_ulp_at(double *a, double *b, size_t n, size_t i,
+		   uint64_t tol, _wh_v2u *e);
+_wh_v4i _wh_ulpf_at(float *a, float *b, size_t n, size_t i,
+		    uint32_t tol, _wh_v4u *e);
+
+/* Print R details of numeric array assertion of N elements with K
+ * elements long WA and WB previews printed with DIGITS precision
+ * and max error in UNIT.  Return 0. */
+int _wh_near_show(struct _wh_near *r, size_t n, double *wa, double *wb,
+		  int k, int digits, char *unit);
+
+/* Return non 0 when A and B files have the same content. */
+int _wh_fsame(char *a, char *b);
+
+/* Return non 0 when PATH file content hash is HEX string.  Hash is
+ * XXH64 of each 1 MiB part of file, seeded with part index, then
+ * XXH64 of those little endian hashes seeded with file size. */
+int _wh_fhash(char *path, char *hex);
+
+/* Map PATH regular file to memory and set its size in SIZ.  Return
+ * NULL on error and print it. */
+char *_wh_map(char *path, size_t *siz);
+
+/* Unmap MAP of SIZ bytes returned by _wh_map(). */
+void _wh_unmap(char *map, size_t siz);
+
+/* Split N bytes between threads as PART array and run FN on each.
+ * Return number of used parts. */
+int _wh_split(void *(*fn)(void *), struct _wh_part *part, size_t n);
+
+/* Thread functions comparing and hashing ARG _wh_part. */
+void *_wh_fsame_part(void *arg);
+void *_wh_fhash_part(void *arg);
+
+/* Return XXH64 hash with SEED of BUF of N size. */
+uint64_t _wh_xxh(char *buf, size_t n, uint64_t seed);
+
+/* Return monotonic clock time in nanoseconds. */
+uint64_t _wh_ns(void);
+
+/* Return monotonic clock time in milliseconds. */
+long _wh_ms(void);
+
+/* Setup IO to read from SRC being either literal string when
+ * prefixed with STR, file path or NULL. */
+void _wh_src(struct _wh_io *io, char *src);
+
+/* Read up to N bytes from IO source to BUF.  Return number of bytes
+ * read, less than N only when source ended. */
+size_t _wh_get(struct _wh_io *io, char *buf, size_t n);
+
+/* Open file for copy of IO output of RUN() at LINE in _wh_dir.
+ * File is named FILE.LINE.out, or FILE.LINE.N.out for N-th RUN()
+ * from the same LINE. */
+void _wh_save(struct _wh_io *io, int line);
 
-/* Write STR to temporary file, rewind, return file descriptor. */
-int _wh_tmp(char *str);
+/* Compare N bytes of BUF received from child with IO source.  First
+ * difference is remembered in IO to be printed by _wh_check(). */
+void _wh_cmp(struct _wh_io *io, char *buf, size_t n);
+
+/* Print details of incorrect IO output.  Return 0 when output is
+ * incorrect. */
+int _wh_check(struct _wh_io *io);
+
+/* Start P process running JOB command. */
+void _wh_spawn(struct _wh_proc *p, struct _wh_job *job);
+
+/* Pass next part of P process standard input.  Return number of
+ * bytes passed, 0 at the end of input or -1 on error. */
+ssize_t _wh_feed(struct _wh_proc *p);
+
+/* Read next part of IO output and compare it.  Return number of
+ * bytes read, 0 at the end of output or -1 on error. */
+ssize_t _wh_drain(struct _wh_io *io);
+
+/* Append N bytes of BUF to IO captured output keeping it null
+ * terminated. */
+void _wh_keep(struct _wh_io *io, char *buf, size_t n);
+
+/* Return N bytes from test arena with LEN bytes of P copied.  When P
+ * of CAP bytes is the last allocation it's extended in place, or its
+ * block is reallocated when P is the only allocation in it. */
+void *_wh_grow(void *p, size_t cap, size_t len, size_t n);
+
+/* Release test arena, keep only its newest block for reuse. */
+void _wh_free(void);
+
+/* Close pipe of IO with its output copy. */
+void _wh_end(struct _wh_io *io);
+
+/* Return non 0 when P process exited and its pipes are closed. */
+int _wh_done(struct _wh_proc *p);
+
+/* Finish comparing outputs of done P process with their sources and
+ * close source files, so only running processes hold them open. */
+void _wh_settle(struct _wh_proc *p);
+
+/* Pass standard input, read output, reap and enforce timeout of N
+ * processes in P array.  Block until there is progress or one of
+ * the deadlines. */
+void _wh_step(struct _wh_proc **p, int n);
+
+/* Send next signal to process group of P on timeout.  SIGTERM goes
+ * first, then SIGKILL, then remaining pipes are abandoned. */
+void _wh_kill(struct _wh_proc *p);
+
+/* Print what went wrong with done P process.  Return 0 on failure. */
+int _wh_report(struct _wh_proc *p);
+
+/* Print details of P process killed on timeout.  Return 0 when P
+ * was killed. */
+int _wh_late(struct _wh_proc *p);
+
+/* Ignore SIGPIPE so writing to child that does not read its input
+ * fails with EPIPE instead of killing test program. */
+void _wh_block(void);
+
+/* Restore SIGPIPE handler after last _wh_block() caller is done. */
+void _wh_unblock(void);
 
 /* Test CMD.  IN, OUT and ERR are optional paths to files used as
  * stdin, stdou and stderr, can be omitted by setting them to NULL.
  * Function will run CMD command with IN file content if given and
  * test if stdout is equal to content of OUT file if given, same for
  * ERR and will compare CODE expected program exit code with actually
- * CMD exit code.  Return 0 on failure. */
-int _wh_run(char *cmd, char *In, char *Out, char *Err, int code);
+ * CMD exit code.  When MS is not 0 then CMD process group is
+ * terminated after MS milliseconds.  Inside BATCH() CMD is only
+ * queued with LINE and MSG of assertion.  Return 0 on failure. */
+int _wh_run(char *cmd, char *In, char *Out, char *Err, int code, int ms,
+	    int line, char *msg);
+
+/* Return new zeroed job at the end of _wh_job queue. */
+struct _wh_job *_wh_queue(void);
+
+/* Run N commands of JOB array, up to MAX at the same time.  Unless
+ * FN is NULL call it with ARG for each done process in order of JOB,
+ * as soon as all previous ones are done.  Return array of done
+ * processes in order of JOB. */
+struct _wh_proc *_wh_exec(struct _wh_job *job, int n, int max,
+			  void (*fn)(struct _wh_proc *, struct _wh_job *,
+				     void *), void *arg);
+
+/* Run CMD with IN like _wh_run() and store its outputs, exit code
+ * and resources usage in R.  Runs at once also inside BATCH().
+ * Return 0 when CMD was killed after MS milliseconds. */
+int _wh_capture(char *cmd, char *In, int ms, int line, WH_CAPTURE *r);
+
+/* Open TIMED() region with NAME from LINE in function with stack
+ * FRAME inside current region.  Close first regions of functions
+ * that already returned. */
+void _wh_enter(char *name, int line, void *frame);
+
+/* Return 1 before body of region with NAME in function with stack
+ * FRAME, then close it with regions left open inside and return 0. */
+int _wh_timed(char *name, void *frame);
+
+/* Close current region at NOW time. */
+void _wh_leave(uint64_t now);
+
+/* Close regions left open by test I that took NS nanoseconds, print
+ * them and write to _wh_prof. */
+void _wh_profile(int i, uint64_t ns);
+
+/* Print regions inside PARENT at DEPTH with percent of ALL time. */
+void _wh_regions_show(int parent, int depth, uint64_t all);
+
+/* Write self time of PARENT region that took NS with STACK of
+ * frames and then its regions to _wh_prof. */
+void _wh_fold(int parent, char *stack, uint64_t ns);
+
+/* Start BATCH() of up to MAX concurrent commands. */
+void _wh_open(int max);
 
-/* Runs _WH_TEST macros, return number of failed tests. */
+/* Return 1 before BATCH() body.  After body run queued commands
+ * and return 0, or 1 with _wh_batch reset when test should end
+ * in quick mode. */
+int _wh_more(void);
+
+/* Run commands queued in BATCH() and report failed ones.  Return
+ * number of failed commands. */
+int _wh_close(void);
+
+/* Queue test programs matching PATTERN.  Pattern without match and
+ * paths that are not executable files are queued as not found. */
+void _wh_glob(char *pattern);
+
+/* Queue test programs matching patterns from PATH file lines.
+ * Empty lines and lines starting with # are ignored. */
+void _wh_list(char *path);
+
+/* Run test programs matching N patterns from ARG array, up to MAX
+ * at the same time.  Print output of each, not interleaved, in
+ * order of patterns as soon as it and all before it are done, then
+ * summary of failures.  Return sum of
+ * programs exit codes being their numbers of failed tests, plus one
+ * for each program killed or not found. */
+int _wh_drive(char **arg, int n, int max);
+
+/* Print output of done P process of JOB test program and count its
+ * failures in ARG _wh_total. */
+void _wh_print(struct _wh_proc *p, struct _wh_job *job, void *arg);
+
+/* Runs _WH_TEST macros or test programs given as arguments, return
+ * number of failed tests. */
 int
 main(int argc, char **argv)
 {
-	int i, fail=0, limit=WH_MAX;
-	while ((i = getopt(argc, argv, "ql:h")) != -1) switch (i) {
+	int i, fail=0, limit=WH_MAX, max=sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t start;
+	while ((i = getopt(argc, argv, "ql:t:o:j:p:h")) != -1) switch (i) {
 		case 'q': _wh_quick = 1; break;
 		case 'l': limit = atoi(optarg); break;
+		case 't': _wh_timeout = atoi(optarg); break;
+		case 'o': _wh_dir = optarg; break;
+		case 'j': max = atoi(optarg); break;
+		case 'p':
+			if (!(_wh_prof = fopen(optarg, "w")))
+				err(1, "fopen(%s)", optarg);
+			break;
 		default: printf(_wh_help, argv[0]); return 1;
 	};
+	if (optind < argc)
+		return _wh_drive(argv + optind, argc - optind, max);
 	for (i=0; i < _wh_all && fail < limit; i++) {
 		if (_wh_only && _wh_desc[i][0] != 'O')
 			continue;
 		_wh_mistake = 0;
+		start = _wh_ns();
 		if (_wh_desc[i][0] != 'S')
 			(*_wh_func[i])();
+		if (_wh_batch)          /* BATCH() left with return */
+			_wh_close();
+		_wh_profile(i, _wh_ns() - start);
+		_wh_free();
 		if (_wh_mistake)
 			fail++;
 		if (_wh_mistake || _wh_desc[i][0] == 'S')
@@ -234,9 +899,99 @@ main(int argc, char **argv)
 	}
 	if (fail)
 		printf("%s\t%d fail\n", _wh_file, fail);
+	if (_wh_prof && fclose(_wh_prof) == EOF)
+		err(1, "fclose");
 	return fail;
 }
 
+void
+_wh_fail(int line, char *msg)
+{
+	__atomic_fetch_add(&_wh_mistake, 1, __ATOMIC_RELAXED);
+	if (_wh_tid == -1)
+		printf("%s:%d:\t%s\n", _wh_file, line, msg);
+	else
+		printf("%s:%d:\t%s\tthread %d\n", _wh_file, line, msg,
+		       _wh_tid);
+}
+
+void
+_wh_stress(void (*fn)(), int n, long iters, int line)
+{
+	struct _wh_thread *t;
+	struct _wh_gate start;
+	long sum;
+	int i;
+	uint64_t from=UINT64_MAX, to=0;
+	assert(n > 0);
+	if (!(t = malloc(n * sizeof *t)))
+		err(1, "malloc");
+	if (pthread_mutex_init(&start.lock, 0) ||
+	    pthread_cond_init(&start.open, 0))
+		errx(1, "pthread_cond_init");
+	start.wait = n+1;
+	for (i=0; i<n; i++) {
+		t[i].tid = i;
+		t[i].iters = iters;
+		t[i].fn = fn;
+		t[i].start = &start;
+		if (pthread_create(&t[i].th, 0, _wh_stress_thread, &t[i]))
+			errx(1, "pthread_create");
+	}
+	_wh_ready(&start);
+	for (i=0, sum=0; i<n; i++) {
+		if (pthread_join(t[i].th, 0))
+			errx(1, "pthread_join");
+		sum += t[i].iters;
+		if (t[i].from < from) from = t[i].from;
+		if (t[i].to > to) to = t[i].to;
+	}
+	pthread_cond_destroy(&start.open);
+	pthread_mutex_destroy(&start.lock);
+	free(t);
+	to = to > from ? to - from : 1;
+	printf("# %s line %d\t%d threads, %ld ops, %.0f ops/s\n",
+	       _wh_file, line, n, sum, sum * 1e9 / to);
+}
+
+void *
+_wh_stress_thread(void *arg)
+{
+	struct _wh_thread *t = arg;
+	long i;
+#ifdef CPU_SET
+	cpu_set_t set;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	CPU_ZERO(&set);
+	CPU_SET(t->tid % (cpus < 1 ? 1 : cpus), &set);
+	pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+#endif
+	_wh_tid = t->tid;
+	_wh_ready(t->start);
+	t->from = _wh_ns();
+	for (i=0; i<t->iters; i++) {
+		_wh_iter = i;
+		t->fn();
+		if (_wh_quick &&
+		    __atomic_load_n(&_wh_mistake, __ATOMIC_RELAXED))
+			break;
+	}
+	t->to = _wh_ns();
+	t->iters = i < t->iters ? i+1 : i;
+	return 0;
+}
+
+void
+_wh_ready(struct _wh_gate *g)
+{
+	pthread_mutex_lock(&g->lock);
+	if (--g->wait == 0)
+		pthread_cond_broadcast(&g->open);
+	while (g->wait)
+		pthread_cond_wait(&g->open, &g->lock);
+	pthread_mutex_unlock(&g->lock);
+}
+
 int
 _wh_eq(int eq, char *a, char *b, size_t n, size_t m)
 {
@@ -262,134 +1017,1315 @@ _wh_eq(int eq, char *a, char *b, size_t n, size_t m)
 	m -= offset;
 	if (n > WH_SHOW) n = WH_SHOW;
 	if (m > WH_SHOW) m = WH_SHOW;
+	_wh_show(i, a, (int)n, b, (int)m);
+	return 0;
+}
+
+void
+_wh_show(size_t i, char *a, int n, char *b, int m)
+{
 	printf("\tFirst incorrect byte at index: %lu\n"
 	       "\t\"%.*s\"\n"
 	       "\t\"%.*s\"\n",
 	       i,
-	       (int)n, a ? a : "<NULL>",
-	       (int)m, b ? b : "<NULL>");
+	       n, a ? a : "<NULL>",
+	       m, b ? b : "<NULL>");
+}
+
+int
+_wh_near(double *a, double *b, size_t n, double x, double y)
+{
+	_WH_NEAR(_wh_near_at, (a, b, n, i, x, y, &e),
+		 _wh_v2l, _wh_v2d, 2, 17, "");
+}
+
+int
+_wh_nearf(float *a, float *b, size_t n, double x, double y)
+{
+	_WH_NEAR(_wh_nearf_at, (a, b, n, i, x, y, &e),
+		 _wh_v4i, _wh_v4f, 4, 9, "");
+}
+
+int
+_wh_neari(int *a, int *b, size_t n, unsigned tol)
+{
+	assert(sizeof(int) == 4);
+	_WH_NEAR(_wh_neari_at, (a, b, n, i, tol, &e),
+		 _wh_v4i, _wh_v4u, 4, 10, "");
+}
+
+int
+_wh_ulp(double *a, double *b, size_t n, unsigned long ulps)
+{
+	_WH_NEAR(_wh_ulp_at, (a, b, n, i, ulps, &e),
+		 _wh_v2l, _wh_v2u, 2, 17, " ulps");
+}
+
+int
+_wh_ulpf(float *a, float *b, size_t n, unsigned long ulps)
+{
+	/* Floats are never more than UINT32_MAX ulps apart */
+	uint32_t tol = ulps > UINT32_MAX ? UINT32_MAX : ulps;
+	_WH_NEAR(_wh_ulpf_at, (a, b, n, i, tol, &e),
+		 _wh_v4i, _wh_v4u, 4, 9, " ulps");
+}
+
+_wh_v2l
+_wh_near_at(double *a, double *b, size_t n, size_t i,
+	    double x, double y, _wh_v2d *e)
+{
+	_wh_v2d va, vb, t, z = {0, 0};
+	_wh_v2l m, s = {INT64_MAX, INT64_MAX};
+	_WH_LOAD(va, vb, a, b, n, i);
+	/* Equal values, also infinities, are near with no error */
+	*e = (_wh_v2d)(~(va == vb) & (_wh_v2l)(va - vb) & s);
+	va = (_wh_v2d)((_wh_v2l)va & s);
+	vb = (_wh_v2d)((_wh_v2l)vb & s);
+	m = va > vb;
+	t = (_wh_v2d)((m & (_wh_v2l)va) | (~m & (_wh_v2l)vb)) * y;
+	m = t > x;
+	t = (_wh_v2d)((m & (_wh_v2l)t) | (~m & (_wh_v2l)(z + x)));
+	/* Infinite error is never near, even with inf tolerance */
+	return ~(*e <= t) | (*e - *e != z);
+}
+
+_wh_v4i
+_wh_nearf_at(float *a, float *b, size_t n, size_t i,
+	     double x, double y, _wh_v4f *e)
+{
+	_wh_v4f va, vb, t, z = {0, 0, 0, 0};
+	_wh_v4i m, s = {INT32_MAX, INT32_MAX, INT32_MAX, INT32_MAX};
+	_WH_LOAD(va, vb, a, b, n, i);
+	/* Equal values, also infinities, are near with no error */
+	*e = (_wh_v4f)(~(va == vb) & (_wh_v4i)(va - vb) & s);
+	va = (_wh_v4f)((_wh_v4i)va & s);
+	vb = (_wh_v4f)((_wh_v4i)vb & s);
+	m = va > vb;
+	t = (_wh_v4f)((m & (_wh_v4i)va) | (~m & (_wh_v4i)vb)) * (float)y;
+	m = t > (float)x;
+	t = (_wh_v4f)((m & (_wh_v4i)t) | (~m & (_wh_v4i)(z + (float)x)));
+	/* Infinite error is never near, even with inf tolerance */
+	return ~(*e <= t) | (*e - *e != z);
+}
+
+_wh_v4i
+_wh_neari_at(int *a, int *b, size_t n, size_t i,
+	     uint32_t tol, _wh_v4u *e)
+{
+	_wh_v4i va, vb;
+	_wh_v4u ua, ub, m;
+	_WH_LOAD(va, vb, a, b, n, i);
+	/* Flip sign bits to compare as unsigned without overflow */
+	ua = (_wh_v4u)va ^ 0x80000000u;
+	ub = (_wh_v4u)vb ^ 0x80000000u;
+	m = (_wh_v4u)(ua > ub);
+	*e = (m & (ua - ub)) | (~m & (ub - ua));
+	return *e > tol;
+}
+
+_wh_v2l
+_wh_ulp_at(double *a, double *b, size_t n, size_t i,
+	   uint64_t tol, _wh_v2u *e)
+{
+	_wh_v2d va, vb;
+	_wh_v2u ua, ub, m, s = {0, 0};
+	_WH_LOAD(va, vb, a, b, n, i);
+	s += (uint64_t)1 << 63;
+	/* Map sign and magnitude bits to ordered unsigned integers,
+	 * so -0 and +0 are the same and neighbors differ by 1 */
+	ua = (_wh_v2u)va;
+	ub = (_wh_v2u)vb;
+	m = (_wh_v2u)((_wh_v2l)ua < 0);
+	ua = (m & (s - (ua & ~s))) | (~m & (s + ua));
+	m = (_wh_v2u)((_wh_v2l)ub < 0);
+	ub = (m & (s - (ub & ~s))) | (~m & (s + ub));
+	m = (_wh_v2u)(ua > ub);
+	*e = (m & (ua - ub)) | (~m & (ub - ua));
+	return (*e > tol) | (va != va) | (vb != vb);
+}
+
+_wh_v4i
+_wh_ulpf_at(float *a, float *b, size_t n, size_t i,
+	    uint32_t tol, _wh_v4u *e)
+{
+	_wh_v4f va, vb;
+	_wh_v4u ua, ub, m, s = {0, 0, 0, 0};
+	_WH_LOAD(va, vb, a, b, n, i);
+	s += 0x80000000u;
+	/* Same mapping as in _wh_ulp_at() */
+	ua = (_wh_v4u)va;
+	ub = (_wh_v4u)vb;
+	m = (_wh_v4u)((_wh_v4i)ua < 0);
+	ua = (m & (s - (ua & ~s))) | (~m & (s + ua));
+	m = (_wh_v4u)((_wh_v4i)ub < 0);
+	ub = (m & (s - (ub & ~s))) | (~m & (s + ub));
+	m = (_wh_v4u)(ua > ub);
+	*e = (m & (ua - ub)) | (~m & (ub - ua));
+	return (*e > tol) | (va != va) | (vb != vb);
+}
+
+int
+_wh_near_show(struct _wh_near *r, size_t n, double *wa, double *wb,
+	      int k, int digits, char *unit)
+{
+	int i, j;
+	double *w;
+	printf("\tFirst incorrect element at index: %lu\n", r->first);
+	for (j=0; j<2; j++) {
+		w = j ? wb : wa;
+		printf("\t{");
+		for (i=0; i<k; i++)
+			printf(" %.*g", digits, w[i]);
+		printf(" }\n");
+	}
+	printf("\t%lu of %lu elements incorrect, "
+	       "max error %.*g%s at index %lu\n",
+	       r->bad, n, digits, r->max, unit, r->worst);
 	return 0;
 }
 
 int
-_wh_fdcmp(int a, char *src)
-{
-	int b, eq=1, is_str;
-	ssize_t n, m;
-	char buf_a[BUFSIZ], buf_b[BUFSIZ];
-	if (!src) {
-		/* Consume A file when no SRC */
-		while (read(a, buf_a, sizeof buf_a) > 0);
+_wh_fsame(char *a, char *b)
+{
+	struct _wh_part part[WH_JOBS];
+	char *ma, *mb;
+	size_t i, n, sa, sb, bad, offset;
+	if (!(ma = _wh_map(a, &sa)))
+		return 0;
+	if (!(mb = _wh_map(b, &sb))) {
+		_wh_unmap(ma, sa);
 		return 0;
 	}
-	is_str = src[0] == STR[0];
-	if (is_str)
-		b = _wh_tmp(src+1);
-	else if ((b = open(src, O_RDONLY)) == -1)
-		err(1, "open(%s)", src);
-	while ((n = read(a, buf_a, sizeof buf_a)) > 0) {
-		m = read(b, buf_b, n);
-		eq = _wh_eq(1, buf_a, buf_b, n, m);
-		if (!eq)
-			goto end;
-	}
-	/* At this point A was read in it's entirely but B might still
-	 * hold more data. */
-	m = read(b, buf_b, sizeof buf_b);
-	if (m > 0)
-		eq = _wh_eq(1, "", buf_b, 0, m);
-end:
-	if (close(b) == -1)
-		err(1, "close(Out)");
-	if (!eq && !is_str)
-		printf("\tIn file: %s\n", src);
-	return !eq;
+	n = bad = sa < sb ? sa : sb;
+	part[0].a = ma;
+	part[0].b = mb;
+	part[0].bad = &bad;
+	_wh_split(_wh_fsame_part, part, n);
+	if (bad == n && sa == sb) {
+		_wh_unmap(ma, sa);
+		_wh_unmap(mb, sb);
+		return 1;
+	}
+	offset = bad - (bad % WH_SHOW);
+	i = sa - offset;
+	n = sb - offset;
+	_wh_show(bad, ma + offset, i > WH_SHOW ? WH_SHOW : i,
+		 mb + offset, n > WH_SHOW ? WH_SHOW : n);
+	printf("\tIn files: %s %s\n", a, b);
+	_wh_unmap(ma, sa);
+	_wh_unmap(mb, sb);
+	return 0;
 }
 
 int
-_wh_tmp(char *str)
+_wh_fhash(char *path, char *hex)
 {
+	struct _wh_part part[WH_JOBS];
+	char *map, got[17];
+	size_t i, n, siz;
+	uint64_t *hash, h;
+	if (!(map = _wh_map(path, &siz)))
+		return 0;
+	n = (siz + _WH_PART - 1) / _WH_PART;
+	if (!(hash = malloc((n ? n : 1) * sizeof *hash)))
+		err(1, "malloc");
+	part[0].a = map;
+	part[0].b = 0;
+	part[0].hash = hash;
+	_wh_split(_wh_fhash_part, part, siz);
+	for (i=0; i<n; i++) {
+		h = hash[i];
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		h = __builtin_bswap64(h);
+#endif
+		memcpy(&hash[i], &h, sizeof h);
+	}
+	h = _wh_xxh((char *)hash, n * sizeof *hash, siz);
+	free(hash);
+	_wh_unmap(map, siz);
+	sprintf(got, "%08lx%08lx", (unsigned long)(h >> 32),
+		(unsigned long)(h & 0xffffffff));
+	for (i=0; i<16 && tolower((unsigned char)hex[i]) == got[i]; i++)
+		;
+	if (i == 16 && !hex[i])
+		return 1;
+	printf("\tIncorrect hash of file: %s\n"
+	       "\t\"%s\"\n"
+	       "\t\"%s\"\n",
+	       path, got, hex);
+	return 0;
+}
+
+char *
+_wh_map(char *path, size_t *siz)
+{
+	struct stat st;
+	char *map, c;
 	int fd;
-	fd = open("/tmp/walter", O_RDWR | O_CREAT | O_TRUNC, 0600);
-	if (fd == -1)
-		err(1, "open(tmp)");
-	if (write(fd, str, strlen(str)) == -1)
-		err(1, "write(tmp)");
-	lseek(fd, 0, SEEK_SET);
-	return fd;
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		printf("\tCan't open file %s: %s\n", path, strerror(errno));
+		if (fd != -1)
+			close(fd);
+		return 0;
+	}
+	/* Files like /proc ones report size 0 but have content */
+	if (!S_ISREG(st.st_mode) ||
+	    (!st.st_size && read(fd, &c, 1) != 0)) {
+		printf("\tNot a regular file %s\n", path);
+		close(fd);
+		return 0;
+	}
+	/* Empty file can't be mapped but has to be valid pointer */
+	*siz = st.st_size;
+	map = !*siz ? _wh_empty
+		: mmap(0, *siz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		printf("\tCan't map file %s: %s\n", path, strerror(errno));
+		map = 0;
+	}
+	close(fd);
+	return map;
+}
+
+void
+_wh_unmap(char *map, size_t siz)
+{
+	if (siz && munmap(map, siz) == -1)
+		err(1, "munmap");
 }
 
 int
-_wh_run(char *cmd, char *In, char *Out, char *Err, int code)
+_wh_split(void *(*fn)(void *), struct _wh_part *part, size_t n)
 {
-	int fd, fd0[2], fd1[2], fd2[2];
-	int result=0, ws, wes;
-	pid_t pid;
-	char buf[BUFSIZ];
-	ssize_t n;
-	assert(cmd);
-	if (pipe(fd0) == -1) err(1, "pipe(in)");
-	if (pipe(fd1) == -1) err(1, "pipe(out)");
-	if (pipe(fd2) == -1) err(1, "pipe(err)");
-	if ((pid = fork()) == -1) err(1, "fork");
-	/* Child process, the CMD */
-	if (pid == 0) {
-		/* Redirect std in, out and err of child to my pipe
-		 * files.  Index 1 is for writing, 0 for reading */
-		close(fd0[1]); close(0); dup(fd0[0]);
-		close(fd1[0]); close(1); dup(fd1[1]);
-		close(fd2[0]); close(2); dup(fd2[1]);
-		if (execl("/bin/sh", "sh", "-c", cmd, NULL) == -1) {
-			perror("execl");
-			result = 1;
+	long cpus;
+	int i, k;
+	size_t step;
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	k = cpus < 1 ? 1 : cpus > WH_JOBS ? WH_JOBS : cpus;
+	/* Each thread gets at least 4 whole parts */
+	step = (n / k + _WH_PART - 1) / _WH_PART * _WH_PART;
+	if (step < 4 * _WH_PART)
+		step = 4 * _WH_PART;
+	for (i=0; i<k; i++) {
+		part[i] = part[0];
+		part[i].from = i * step;
+		part[i].to = part[i].from + step < n ? part[i].from + step : n;
+		if (i && part[i].from >= n)
+			break;
+		if (i && pthread_create(&part[i].th, 0, fn, &part[i]))
+			errx(1, "pthread_create");
+	}
+	k = i;
+	fn(&part[0]);
+	for (i=1; i<k; i++)
+		if (pthread_join(part[i].th, 0))
+			errx(1, "pthread_join");
+	return k;
+}
+
+void *
+_wh_fsame_part(void *arg)
+{
+	struct _wh_part *p = arg;
+	size_t i, n, bad;
+	for (i = p->from; i < p->to; i += n) {
+		/* Stop when other thread found earlier difference */
+		if (__atomic_load_n(p->bad, __ATOMIC_RELAXED) <= i)
+			break;
+		n = p->to - i < _WH_PART ? p->to - i : _WH_PART;
+		if (!memcmp(p->a + i, p->b + i, n))
+			continue;
+		while (p->a[i] == p->b[i])
+			i++;
+		bad = __atomic_load_n(p->bad, __ATOMIC_RELAXED);
+		while (i < bad && !__atomic_compare_exchange_n(p->bad, &bad,
+			i, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+		break;
+	}
+	return 0;
+}
+
+void *
+_wh_fhash_part(void *arg)
+{
+	struct _wh_part *p = arg;
+	size_t i, n;
+	for (i = p->from; i < p->to; i += n) {
+		n = p->to - i < _WH_PART ? p->to - i : _WH_PART;
+		p->hash[i / _WH_PART] = _wh_xxh(p->a + i, n, i / _WH_PART);
+	}
+	return 0;
+}
+
+/* XXH64 primes and helpers */
+#define _WH_P1 UINT64_C(0x9E3779B185EBCA87)
+#define _WH_P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define _WH_P3 UINT64_C(0x165667B19E3779F9)
+#define _WH_P4 UINT64_C(0x85EBCA77C2B2AE63)
+#define _WH_P5 UINT64_C(0x27D4EB2F165667C5)
+#define _WH_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+#define _WH_ROUND(acc, x) \
+	(_WH_ROTL((acc) + (x) * _WH_P2, 31) * _WH_P1)
+#define _WH_MERGE(h, v) \
+	((((h) ^ _WH_ROUND(0, v)) * _WH_P1) + _WH_P4)
+
+uint64_t
+_wh_xxh(char *buf, size_t n, uint64_t seed)
+{
+	unsigned char *p = (unsigned char *)buf, *end = p + n;
+	uint64_t h, k, v[4];
+	uint32_t w;
+	int i;
+	if (n >= 32) {
+		v[0] = seed + _WH_P1 + _WH_P2;
+		v[1] = seed + _WH_P2;
+		v[2] = seed;
+		v[3] = seed - _WH_P1;
+		for (; p + 32 <= end; p += 32)
+			for (i=0; i<4; i++) {
+				memcpy(&k, p + i*8, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+				k = __builtin_bswap64(k);
+#endif
+				v[i] = _WH_ROUND(v[i], k);
+			}
+		h = _WH_ROTL(v[0], 1) + _WH_ROTL(v[1], 7) +
+			_WH_ROTL(v[2], 12) + _WH_ROTL(v[3], 18);
+		for (i=0; i<4; i++)
+			h = _WH_MERGE(h, v[i]);
+	} else
+		h = seed + _WH_P5;
+	h += n;
+	for (; p + 8 <= end; p += 8) {
+		memcpy(&k, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		k = __builtin_bswap64(k);
+#endif
+		h ^= _WH_ROUND(0, k);
+		h = _WH_ROTL(h, 27) * _WH_P1 + _WH_P4;
+	}
+	if (p + 4 <= end) {
+		memcpy(&w, p, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		w = __builtin_bswap32(w);
+#endif
+		h ^= w * _WH_P1;
+		h = _WH_ROTL(h, 23) * _WH_P2 + _WH_P3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= *p * _WH_P5;
+		h = _WH_ROTL(h, 11) * _WH_P1;
+	}
+	h ^= h >> 33;
+	h *= _WH_P2;
+	h ^= h >> 29;
+	h *= _WH_P3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t
+_wh_ns(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+		err(1, "clock_gettime");
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+#else
+	struct timeval tv;
+	if (gettimeofday(&tv, 0) == -1)
+		err(1, "gettimeofday");
+	return (uint64_t)tv.tv_sec*1000000000 + tv.tv_usec*1000;
+#endif
+}
+
+long
+_wh_ms(void)
+{
+	return _wh_ns() / 1000000;
+}
+
+void
+_wh_src(struct _wh_io *io, char *src)
+{
+	io->src = -1;
+	io->path = 0;
+	io->str = 0;
+	io->len = 0;
+	if (!src)
+		return;
+	if (src[0] == STR[0]) {
+		io->str = src+1;
+		io->len = strlen(io->str);
+	} else if ((io->src = open(src, O_RDONLY | _WH_CLOEXEC)) == -1)
+		err(1, "open(%s)", src);
+	else {
+		fcntl(io->src, F_SETFD, FD_CLOEXEC);
+		io->path = src;
+	}
+}
+
+size_t
+_wh_get(struct _wh_io *io, char *buf, size_t n)
+{
+	size_t got=0;
+	ssize_t m;
+	if (io->str) {
+		if (n > io->len) n = io->len;
+		memcpy(buf, io->str, n);
+		io->str += n;
+		io->len -= n;
+		return n;
+	}
+	while (got < n && (m = read(io->src, buf+got, n-got)) != 0) {
+		if (m == -1 && errno != EINTR)
+			err(1, "read(%s)", io->path);
+		if (m > 0)
+			got += m;
+	}
+	return got;
+}
+
+void
+_wh_save(struct _wh_io *io, int line)
+{
+	char path[4096], *name;
+	int n;
+	name = strrchr(_wh_file, '/');
+	name = name ? name+1 : _wh_file;
+	pthread_mutex_lock(&_wh_lock);
+	if (line >= _wh_saved_max) {
+		n = line + 64;
+		if (!(_wh_saved = realloc(_wh_saved, n * sizeof *_wh_saved)))
+			err(1, "realloc");
+		memset(_wh_saved + _wh_saved_max, 0,
+		       (n - _wh_saved_max) * sizeof *_wh_saved);
+		_wh_saved_max = n;
+	}
+	n = ++_wh_saved[line];
+	pthread_mutex_unlock(&_wh_lock);
+	if (n == 1)
+		sprintf(path, "%.3000s/%.1000s.%d.out", _wh_dir, name, line);
+	else
+		sprintf(path, "%.3000s/%.1000s.%d.%d.out", _wh_dir, name,
+			line, n);
+	io->save = open(path, O_WRONLY | O_CREAT | O_TRUNC | _WH_CLOEXEC,
+			0644);
+	if (io->save == -1)
+		err(1, "open(%s)", path);
+	fcntl(io->save, F_SETFD, FD_CLOEXEC);
+#ifdef SPLICE_F_NONBLOCK
+	if (pipe(io->dup) == -1)
+		err(1, "pipe");
+	fcntl(io->dup[0], F_SETFD, FD_CLOEXEC);
+	fcntl(io->dup[1], F_SETFD, FD_CLOEXEC);
+#else
+	io->copy = 1;
+#endif
+}
+
+void
+_wh_cmp(struct _wh_io *io, char *buf, size_t n)
+{
+	char want[BUFSIZ];
+	size_t i=0, m, offset, drop;
+	assert(n <= sizeof want);
+	/* Remember tail of output for timeout message */
+	if (n >= WH_SHOW) {
+		memcpy(io->tail, buf + n - WH_SHOW, WH_SHOW);
+		io->tn = WH_SHOW;
+	} else {
+		if (io->tn + n > WH_SHOW) {
+			drop = io->tn + n - WH_SHOW;
+			memmove(io->tail, io->tail + drop, io->tn - drop);
+			io->tn -= drop;
+		}
+		memcpy(io->tail + io->tn, buf, n);
+		io->tn += n;
+	}
+	if (!io->bad && (io->src != -1 || io->str)) {
+		m = _wh_get(io, want, n);
+		while (i<m && buf[i] == want[i])
+			i++;
+		if (i < n) {
+			offset = i - (i % WH_SHOW);
+			io->bad = 1;
+			io->at = io->n + i;
+			io->an = n - offset > WH_SHOW ? WH_SHOW : n - offset;
+			io->bn = m <= offset ? 0 :
+				m - offset > WH_SHOW ? WH_SHOW : m - offset;
+			memcpy(io->a, buf + offset, io->an);
+			memcpy(io->b, want + offset, io->bn);
 		}
-		close(fd0[0]);
-		close(fd1[1]);
-		close(fd2[1]);
-		exit(result);
+	}
+	io->n += n;
+}
+
+int
+_wh_check(struct _wh_io *io)
+{
+	if (!io->bad)
+		return 1;
+	_wh_show(io->at, io->a, io->an, io->b, io->bn);
+	if (io->path)
+		printf("\tIn file: %s\n", io->path);
+	return 0;
+}
+
+void
+_wh_spawn(struct _wh_proc *p, struct _wh_job *job)
+{
+	int i, fd[3][2];
+	assert(job->cmd);
+	memset(p, 0, sizeof *p);
+	_wh_src(&p->io[0], job->in);
+	_wh_src(&p->io[1], job->out);
+	_wh_src(&p->io[2], job->err);
+	for (i=0; i<3; i++) {
+		if (pipe(fd[i]) == -1)
+			err(1, "pipe");
+		fcntl(fd[i][0], F_SETFD, FD_CLOEXEC);
+		fcntl(fd[i][1], F_SETFD, FD_CLOEXEC);
+	}
+	if ((p->pid = fork()) == -1)
+		err(1, "fork");
+	/* Child process, the CMD */
+	if (p->pid == 0) {
+		/* Own process group so timeout can kill whole CMD
+		 * pipeline.  Redirect std in, out and err to my pipe
+		 * files.  Index 1 is for writing, 0 for reading. */
+		setpgid(0, 0);
+		dup2(fd[0][0], 0);
+		dup2(fd[1][1], 1);
+		dup2(fd[job->prog ? 1 : 2][1], 2);
+		/* Ignored signals stay ignored across exec */
+		signal(SIGPIPE, SIG_DFL);
+		if (job->prog)
+			execl(job->cmd, job->cmd, NULL);
+		else
+			execl("/bin/sh", "sh", "-c", job->cmd, NULL);
+		perror("execl");
+		_exit(1);
 	}
 	/* Parent process */
-	close(fd0[0]);
-	close(fd1[1]);
-	close(fd2[1]);
-	/* Pass standard input */
-	if (In) {
-		if (In[0] == STR[0])
-			fd = _wh_tmp(In+1);
-		else if ((fd = open(In, O_RDONLY)) == -1)
-			err(1, "open(In)");
-		while ((n = read(fd, buf, BUFSIZ)) > 0)
-			if (write(fd0[1], buf, n) == -1) {
-				perror("write(In)");
-				return 0;
+	setpgid(p->pid, p->pid);
+	close(fd[0][0]);
+	close(fd[1][1]);
+	close(fd[2][1]);
+	p->io[0].fd = fd[0][1];
+	p->io[1].fd = fd[1][0];
+	p->io[2].fd = fd[2][0];
+	fcntl(p->io[0].fd, F_SETFL, O_NONBLOCK);
+	for (i=0; i<3; i++)
+		p->io[i].save = -1;
+	if (!job->in)
+		_wh_end(&p->io[0]);
+	if (_wh_dir && !job->prog)
+		_wh_save(&p->io[1], job->line);
+	p->io[1].keep = job->keep;
+	p->io[2].keep = job->keep;
+	p->alive = 1;
+	p->pidfd = -1;
+#if defined(SYS_pidfd_open) && defined(_DEFAULT_SOURCE)
+	p->pidfd = syscall(SYS_pidfd_open, p->pid, 0);
+	if (p->pidfd != -1)
+		fcntl(p->pidfd, F_SETFD, FD_CLOEXEC);
+#endif
+	p->code = job->code;
+	p->ms = job->ms;
+	p->end = job->ms ? _wh_ms() + job->ms : 0;
+}
+
+int
+_wh_done(struct _wh_proc *p)
+{
+	return !p->alive && p->io[0].fd == -1 &&
+		p->io[1].fd == -1 && p->io[2].fd == -1;
+}
+
+void
+_wh_settle(struct _wh_proc *p)
+{
+	struct _wh_io *io;
+	int i;
+	for (i=0; i<3; i++) {
+		io = &p->io[i];
+		/* Output ended but source might still hold more data,
+		 * unless process was killed before it could end. */
+		if (i && !p->sig && !io->bad &&
+		    (io->src != -1 || io->str)) {
+			io->bn = _wh_get(io, io->b, sizeof io->b);
+			if (io->bn) {
+				io->bad = 1;
+				io->at = io->n;
+				io->an = 0;
 			}
-		if (close(fd) == -1)
-			err(1, "close(In)");
+		}
+		io->str = 0;
+		if (io->src != -1 && close(io->src) == -1)
+			err(1, "close(%s)", io->path);
+		io->src = -1;
 	}
-	if (close(fd0[1]) == -1)
-		err(1, "close(fd0[1])");
-	/* Compare standard output */
-	if (_wh_fdcmp(fd1[0], Out))
-		return 0;
-	if (close(fd1[0]) == -1)
-		err(1, "close(fd1[0])");
-	/* Compare standard error */
-	if (_wh_fdcmp(fd2[0], Err))
-		return 0;
-	if (close(fd2[0]) == -1)
-		err(1, "close(fd2[0])");
-	/* Wait for child process to exit */
-	if (waitpid(pid, &ws, 0) == -1) {
-		perror("waitpid");
+}
+
+void
+_wh_step(struct _wh_proc **p, int n)
+{
+	struct pollfd buf[4*WH_JOBS], *fds=buf;
+	struct _wh_io *io;
+	int i, j, k=0, ms=-1;
+	long left, now;
+	ssize_t m;
+	/* Only -j can run more than WH_JOBS at once */
+	if (n > WH_JOBS && !(fds = malloc(4 * n * sizeof *fds)))
+		err(1, "malloc");
+	now = _wh_ms();
+	for (i=0; i<n; i++) {
+		for (j=0; j<3; j++) {
+			if (p[i]->io[j].fd == -1)
+				continue;
+			fds[k].fd = p[i]->io[j].fd;
+			fds[k].events = j ? POLLIN : POLLOUT;
+			k++;
+		}
+		if (p[i]->alive && p[i]->pidfd != -1) {
+			fds[k].fd = p[i]->pidfd;
+			fds[k].events = POLLIN;
+			k++;
+		} else if (p[i]->alive && (ms == -1 || ms > 10))
+			ms = 10;        /* Poll for child exit */
+		if (p[i]->end) {
+			left = p[i]->end - now;
+			if (left < 0) left = 0;
+			if (ms == -1 || left < ms) ms = left;
+		}
+	}
+	if (poll(fds, k, ms) == -1 && errno != EINTR)
+		err(1, "poll");
+	for (i=0, k=0; i<n; i++) {
+		for (j=0; j<3; j++) {
+			io = &p[i]->io[j];
+			if (io->fd == -1 || !fds[k++].revents)
+				continue;
+			m = j ? _wh_drain(io) : _wh_feed(p[i]);
+			if (m > 0 ||
+			    (m == -1 && (errno == EAGAIN || errno == EINTR)))
+				continue;
+			/* End of input, output or child stopped reading */
+			_wh_end(io);
+		}
+		if (p[i]->alive && p[i]->pidfd != -1)
+			k++;
+	}
+	if (fds != buf)
+		free(fds);
+	now = _wh_ms();
+	for (i=0; i<n; i++) {
+		if (p[i]->alive) {
+			m = wait4(p[i]->pid, &p[i]->ws, WNOHANG, &p[i]->ru);
+			if (m == -1)
+				err(1, "wait4");
+			if (m) {
+				p[i]->alive = 0;
+				if (p[i]->pidfd != -1)
+					close(p[i]->pidfd);
+			}
+		}
+		if (p[i]->end && now >= p[i]->end && !_wh_done(p[i]))
+			_wh_kill(p[i]);
+	}
+}
+
+ssize_t
+_wh_feed(struct _wh_proc *p)
+{
+	struct _wh_io *io = &p->io[0];
+	ssize_t m;
+#ifdef SPLICE_F_NONBLOCK
+	/* Move IN file pages straight into the pipe */
+	if (io->src != -1 && !io->copy) {
+		m = splice(io->src, 0, io->fd, 0, 1 << 16,
+			   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (m != -1 || errno == EAGAIN || errno == EPIPE) {
+			if (m > 0) io->n += m;
+			return m;
+		}
+		io->copy = 1;   /* Not supported, fallback to copy */
+	}
+#endif
+	if (p->off == p->len) {
+		p->off = 0;
+		p->len = _wh_get(io, p->buf, sizeof p->buf);
+	}
+	if (p->off == p->len)
 		return 0;
+	m = write(io->fd, p->buf + p->off, p->len - p->off);
+	if (m > 0) {
+		p->off += m;
+		io->n += m;
+	}
+	return m;
+}
+
+ssize_t
+_wh_drain(struct _wh_io *io)
+{
+	char buf[BUFSIZ];
+	size_t n = sizeof buf;
+	ssize_t m, w;
+#ifdef SPLICE_F_NONBLOCK
+	/* Duplicate pipe content into SAVE file without reading it,
+	 * then read only as much as was duplicated. */
+	if (io->save != -1 && !io->copy && !io->teed) {
+		m = tee(io->fd, io->dup[1], 1 << 16, SPLICE_F_NONBLOCK);
+		if (m == 0 || (m == -1 && errno == EAGAIN))
+			return m;
+		if (m == -1)
+			io->copy = 1;   /* Not supported */
+		else
+			io->teed = m;
+		for (; m > 0; m -= w)
+			if ((w = splice(io->dup[0], 0, io->save, 0, m,
+					SPLICE_F_MOVE)) <= 0)
+				err(1, "splice(save)");
+	}
+	if (io->teed && n > io->teed)
+		n = io->teed;
+#endif
+	if ((m = read(io->fd, buf, n)) <= 0)
+		return m;
+	if (io->teed)
+		io->teed -= m;
+	else if (io->save != -1)
+		for (n=0; n < (size_t)m; n += w)
+			if ((w = write(io->save, buf+n, m-n)) == -1)
+				err(1, "write(save)");
+	if (io->keep)
+		_wh_keep(io, buf, m);
+	_wh_cmp(io, buf, m);
+	return m;
+}
+
+void
+_wh_keep(struct _wh_io *io, char *buf, size_t n)
+{
+	size_t cap = io->cap;
+	while (io->n + n >= cap)
+		cap = cap ? cap*2 : BUFSIZ;
+	if (cap != io->cap) {
+		io->buf = _wh_grow(io->buf, io->cap, io->n, cap);
+		io->cap = cap;
+	}
+	memcpy(io->buf + io->n, buf, n);
+	io->buf[io->n + n] = 0;
+}
+
+void *
+_wh_grow(void *p, size_t cap, size_t len, size_t n)
+{
+	struct _wh_arena *a;
+	size_t at, size;
+	char *q;
+	n = (n + 15) & ~(size_t)15;     /* Keep 16 bytes alignment */
+	pthread_mutex_lock(&_wh_lock);
+	a = _wh_arena;
+	at = p && a ? (size_t)((char *)p - a->mem) : 0;
+	if (p && a && at < a->size &&
+	    at + ((cap + 15) & ~(size_t)15) == a->used) {
+		if (at + n > a->size && at == 0) {
+			/* Only allocation of block, move whole block */
+			size = a->size*2 < n ? n : a->size*2;
+			if (!(a = realloc(a, sizeof *a + size)))
+				err(1, "realloc");
+			a->size = size;
+			a->mem = (char *)(a + 1);
+			_wh_arena = a;
+		}
+		if (at + n <= a->size) {
+			a->used = at + n;       /* Last one, extend */
+			pthread_mutex_unlock(&_wh_lock);
+			return a->mem + at;
+		}
+	}
+	if (!a || a->used + n > a->size) {
+		size = !a ? 1 << 16 : a->size < 1 << 20 ? a->size*2 : 1 << 20;
+		if (size < n)
+			size = n;
+		if (!(a = malloc(sizeof *a + size)))
+			err(1, "malloc");
+		a->next = _wh_arena;
+		a->size = size;
+		a->used = 0;
+		a->mem = (char *)(a + 1);
+		_wh_arena = a;
+	}
+	q = a->mem + a->used;
+	a->used += n;
+	pthread_mutex_unlock(&_wh_lock);
+	if (p)
+		memcpy(q, p, len);
+	return q;
+}
+
+void
+_wh_free(void)
+{
+	struct _wh_arena *a, *next;
+	if (!_wh_arena)
+		return;
+	for (a = _wh_arena->next; a; a = next) {
+		next = a->next;
+		free(a);
+	}
+	_wh_arena->next = 0;
+	_wh_arena->used = 0;
+}
+
+void
+_wh_end(struct _wh_io *io)
+{
+	if (close(io->fd) == -1)
+		err(1, "close");
+	io->fd = -1;
+	if (io->save == -1)
+		return;
+	if (close(io->save) == -1)
+		err(1, "close(save)");
+	io->save = -1;
+#ifdef SPLICE_F_NONBLOCK
+	close(io->dup[0]);
+	close(io->dup[1]);
+#endif
+}
+
+void
+_wh_kill(struct _wh_proc *p)
+{
+	int i;
+	switch (p->sig) {
+	case 0:       p->sig = SIGTERM; break;
+	case SIGTERM: p->sig = SIGKILL; break;
+	default:
+		/* Process group is dead but something else still
+		 * holds the pipes open, give up on them. */
+		for (i=0; i<3; i++)
+			if (p->io[i].fd != -1)
+				_wh_end(&p->io[i]);
+		p->end = 0;
+		return;
 	}
+	if (kill(-p->pid, p->sig) == -1 && errno != ESRCH)
+		err(1, "kill");
+	p->end = _wh_ms() + WH_KILL;
+}
+
+int
+_wh_report(struct _wh_proc *p)
+{
+	int ok;
+	_wh_settle(p);
+	ok = _wh_late(p);
+	ok &= _wh_check(&p->io[1]);
+	ok &= _wh_check(&p->io[2]);
+	if (p->sig)
+		return 0;
 	/* Get child process exit code */
-	if (WIFEXITED(ws) && (wes = WEXITSTATUS(ws)) != code) {
+	if (WIFEXITED(p->ws) && WEXITSTATUS(p->ws) != p->code) {
 		printf("\tExpected exit code %d, got %d\n",
-			code, wes);
+		       p->code, WEXITSTATUS(p->ws));
 		return 0;
 	}
-	return 1;
+	if (WIFSIGNALED(p->ws)) {
+		printf("\tExpected exit code %d, got signal %d\n",
+		       p->code, WTERMSIG(p->ws));
+		return 0;
+	}
+	return ok;
+}
+
+int
+_wh_late(struct _wh_proc *p)
+{
+	int i;
+	if (!p->sig)
+		return 1;
+	printf("\tTimeout after %d ms, sent %s\n", p->ms,
+	       p->sig == SIGTERM ? "SIGTERM" : "SIGKILL");
+	for (i=1; i<3; i++)
+		printf("\t%s %lu bytes, last: \"%.*s\"\n",
+		       i == 1 ? "Stdout" : "Stderr",
+		       p->io[i].n, p->io[i].tn, p->io[i].tail);
+	return 0;
+}
+
+void
+_wh_block(void)
+{
+	pthread_mutex_lock(&_wh_lock);
+	if (!_wh_blocked++)
+		_wh_sigpipe = signal(SIGPIPE, SIG_IGN);
+	pthread_mutex_unlock(&_wh_lock);
+}
+
+void
+_wh_unblock(void)
+{
+	pthread_mutex_lock(&_wh_lock);
+	if (!--_wh_blocked)
+		signal(SIGPIPE, _wh_sigpipe);
+	pthread_mutex_unlock(&_wh_lock);
+}
+
+int
+_wh_run(char *cmd, char *In, char *Out, char *Err, int code, int ms,
+	int line, char *msg)
+{
+	struct _wh_proc proc, *p=&proc;
+	struct _wh_job one, *job=&one;
+	if (_wh_batch)
+		job = _wh_queue();
+	else
+		memset(job, 0, sizeof *job);
+	job->cmd = cmd;
+	job->in = In;
+	job->out = Out;
+	job->err = Err;
+	job->code = code;
+	job->ms = ms;
+	job->line = line;
+	job->msg = msg;
+	if (_wh_batch)
+		return 1;       /* Reported by _wh_close() */
+	_wh_block();
+	_wh_spawn(p, job);
+	while (!_wh_done(p))
+		_wh_step(&p, 1);
+	_wh_unblock();
+	return _wh_report(p);
+}
+
+struct _wh_job *
+_wh_queue(void)
+{
+	if (_wh_jobs == _wh_jobs_max) {
+		_wh_jobs_max = _wh_jobs_max ? _wh_jobs_max*2 : 16;
+		_wh_job = realloc(_wh_job, _wh_jobs_max * sizeof *_wh_job);
+		if (!_wh_job)
+			err(1, "realloc");
+	}
+	memset(&_wh_job[_wh_jobs], 0, sizeof *_wh_job);
+	return &_wh_job[_wh_jobs++];
+}
+
+struct _wh_proc *
+_wh_exec(struct _wh_job *job, int n, int max,
+	 void (*fn)(struct _wh_proc *, struct _wh_job *, void *), void *arg)
+{
+	struct _wh_proc *proc, **run;
+	int i, k=0, next=0, shown=0;
+	max = max < 1 ? 1 : max > n ? n : max;
+	if (!(proc = malloc((n ? n : 1) * sizeof *proc)) ||
+	    !(run = malloc((max ? max : 1) * sizeof *run)))
+		err(1, "malloc");
+	_wh_block();
+	while (next < n || k) {
+		for (; k < max && next < n; next++) {
+			if (job[next].none)
+				continue;
+			_wh_spawn(&proc[next], &job[next]);
+			run[k++] = &proc[next];
+		}
+		if (k)
+			_wh_step(run, k);
+		/* Close sources of done ones before starting next */
+		for (i=0; i<k; i++) {
+			if (_wh_done(run[i])) {
+				_wh_settle(run[i]);
+				run[i--] = run[--k];
+			}
+		}
+		for (; fn && shown < next; shown++) {
+			if (!job[shown].none && !_wh_done(&proc[shown]))
+				break;
+			fn(&proc[shown], &job[shown], arg);
+		}
+	}
+	_wh_unblock();
+	free(run);
+	return proc;
+}
+
+int
+_wh_capture(char *cmd, char *In, int ms, int line, WH_CAPTURE *r)
+{
+	struct _wh_proc proc, *p=&proc;
+	struct _wh_job job;
+	memset(&job, 0, sizeof job);
+	job.cmd = cmd;
+	job.in = In;
+	job.ms = ms;
+	job.line = line;
+	job.keep = 1;
+	_wh_block();
+	_wh_spawn(p, &job);
+	while (!_wh_done(p))
+		_wh_step(&p, 1);
+	_wh_unblock();
+	_wh_settle(p);
+	r->out = p->io[1].buf ? p->io[1].buf : "";
+	r->err = p->io[2].buf ? p->io[2].buf : "";
+	r->outn = p->io[1].n;
+	r->errn = p->io[2].n;
+	r->code = WIFEXITED(p->ws) ? WEXITSTATUS(p->ws) : -1;
+	r->sig = WIFSIGNALED(p->ws) ? WTERMSIG(p->ws) : 0;
+	r->ru = p->ru;
+	return _wh_late(p);
+}
+
+void
+_wh_enter(char *name, int line, void *frame)
+{
+	struct _wh_region *r;
+	uint64_t now=0;
+	int i;
+	/* Stack grows down so frames below FRAME are gone */
+	while (_wh_top != -1 && _wh_region[_wh_top].frame < (char *)frame)
+		_wh_leave(now ? now : (now = _wh_ns()));
+	for (i=_wh_regions-1; i>=0; i--) {
+		r = &_wh_region[i];
+		if (r->parent == _wh_top &&
+		    (r->name == name || !strcmp(r->name, name)))
+			break;
+	}
+	if (i < 0) {
+		assert(_wh_regions < WH_REGIONS);
+		i = _wh_regions++;
+		r = &_wh_region[i];
+		memset(r, 0, sizeof *r);
+		r->name = name;
+		r->line = line;
+		r->parent = _wh_top;
+	}
+	r->body = 0;
+	r->frame = frame;
+	_wh_top = i;
+	r->start = _wh_ns();    /* Last so lookup is not measured */
+}
+
+int
+_wh_timed(char *name, void *frame)
+{
+	struct _wh_region *r;
+	uint64_t now;
+	int mine=0;
+	r = &_wh_region[_wh_top];
+	if (!r->body)
+		return r->body = 1;
+	now = _wh_ns();
+	/* Also close regions left with return from inlined functions */
+	while (_wh_top != -1 && !mine) {
+		r = &_wh_region[_wh_top];
+		mine = r->frame == (char *)frame &&
+			(r->name == name || !strcmp(r->name, name));
+		_wh_leave(now);
+	}
+	return 0;
+}
+
+void
+_wh_leave(uint64_t now)
+{
+	struct _wh_region *r = &_wh_region[_wh_top];
+	r->ns += now - r->start;
+	r->count++;
+	r->body = 0;
+	_wh_top = r->parent;
+}
+
+void
+_wh_profile(int i, uint64_t ns)
+{
+	uint64_t now = _wh_ns();
+	while (_wh_top != -1)
+		_wh_leave(now);
+	if (!_wh_regions)
+		return;
+	_wh_regions_show(-1, 0, ns);
+	if (_wh_prof)
+		_wh_fold(-1, _wh_desc[i] + 5, ns);     /* Skip type */
+	_wh_regions = 0;
+}
+
+void
+_wh_regions_show(int parent, int depth, uint64_t all)
+{
+	struct _wh_region *r;
+	int i;
+	for (i=0; i<_wh_regions; i++) {
+		r = &_wh_region[i];
+		if (r->parent != parent)
+			continue;
+		printf("# %s line %d\t%*s%s\t%.3f ms\t%ld runs\t%.0f%%\n",
+		       _wh_file, r->line, depth*2, "", r->name,
+		       r->ns / 1e6, r->count,
+		       all ? r->ns * 100.0 / all : 0.0);
+		_wh_regions_show(i, depth+1, all);
+	}
+}
+
+void
+_wh_fold(int parent, char *stack, uint64_t ns)
+{
+	char path[4096];
+	uint64_t self = ns;
+	int i;
+	for (i=0; i<_wh_regions; i++)
+		if (_wh_region[i].parent == parent)
+			self -= self < _wh_region[i].ns ?
+				self : _wh_region[i].ns;
+	fprintf(_wh_prof, "%s %lu\n", stack, (unsigned long)(self / 1000));
+	for (i=0; i<_wh_regions; i++) {
+		if (_wh_region[i].parent != parent)
+			continue;
+		sprintf(path, "%.3000s;%.1000s", stack, _wh_region[i].name);
+		_wh_fold(i, path, _wh_region[i].ns);
+	}
+}
+
+void
+_wh_open(int max)
+{
+	assert(!_wh_batch);     /* BATCH() can't be nested */
+	_wh_batch = max < 1 ? 1 : max > WH_JOBS ? WH_JOBS : max;
+	_wh_stage = 0;
+	_wh_jobs = 0;
+}
+
+int
+_wh_more(void)
+{
+	if (!_wh_stage)
+		return _wh_stage = 1;
+	return _wh_close() && _wh_quick;
+}
+
+int
+_wh_close(void)
+{
+	struct _wh_proc *proc;
+	int i, fail=0;
+	proc = _wh_exec(_wh_job, _wh_jobs, _wh_batch, 0, 0);
+	/* Report in order of RUN() assertions */
+	for (i=0; i<_wh_jobs; i++) {
+		if (!_wh_report(&proc[i])) {
+			_wh_fail(_wh_job[i].line, _wh_job[i].msg);
+			fail++;
+		}
+	}
+	free(proc);
+	_wh_batch = 0;
+	_wh_jobs = 0;
+	return fail;
+}
+
+void
+_wh_glob(char *pattern)
+{
+	struct _wh_job *job;
+	glob_t g;
+	size_t i;
+	char *path;
+	struct stat st;
+	/* Without match pattern is used as is, to be reported */
+	if (glob(pattern, GLOB_NOCHECK, 0, &g))
+		errx(1, "glob(%s)", pattern);
+	for (i=0; i<g.gl_pathc; i++) {
+		path = g.gl_pathv[i];
+		job = _wh_queue();
+		if (!(job->cmd = malloc(strlen(path) + 1)))
+			err(1, "malloc");
+		strcpy(job->cmd, path);
+		job->ms = _wh_timeout;
+		job->keep = 1;
+		job->prog = 1;
+		job->none = stat(path, &st) == -1 || !S_ISREG(st.st_mode) ||
+			access(path, X_OK) == -1;
+	}
+	globfree(&g);
+}
+
+void
+_wh_list(char *path)
+{
+	char line[4096];
+	size_t n;
+	FILE *fp;
+	if (!(fp = fopen(path, "r")))
+		err(1, "fopen(%s)", path);
+	while (fgets(line, sizeof line, fp)) {
+		n = strlen(line);
+		if (n && line[n-1] == '\n')
+			line[--n] = 0;
+		if (n && line[0] != '#')
+			_wh_glob(line);
+	}
+	if (ferror(fp))
+		err(1, "fgets(%s)", path);
+	fclose(fp);
+}
+
+int
+_wh_drive(char **arg, int n, int max)
+{
+	struct _wh_total t;
+	int i;
+	memset(&t, 0, sizeof t);
+	for (i=0; i<n; i++) {
+		if (arg[i][0] == '@')
+			_wh_list(arg[i] + 1);
+		else
+			_wh_glob(arg[i]);
+	}
+	/* Printed in order of patterns as soon as possible */
+	free(_wh_exec(_wh_job, _wh_jobs, max, _wh_print, &t));
+	if (t.bad || t.none)
+		printf("%d fail in %d of %d programs, %d not found\n",
+		       t.fail, t.bad, _wh_jobs, t.none);
+	_wh_free();
+	/* Each not found program counts as one failure */
+	t.fail += t.none;
+	return t.fail > 255 ? 255 : t.fail;
+}
+
+void
+_wh_print(struct _wh_proc *p, struct _wh_job *job, void *arg)
+{
+	struct _wh_total *t = arg;
+	int code;
+	if (job->none) {
+		printf("%s\tNo such program\n", job->cmd);
+		t->none++;
+	} else {
+		if (p->io[1].n)
+			fwrite(p->io[1].buf, 1, p->io[1].n, stdout);
+		if (p->sig) {
+			printf("%s\tTimeout after %d ms, sent %s\n",
+			       job->cmd, p->ms,
+			       p->sig == SIGTERM ? "SIGTERM" : "SIGKILL");
+			code = 1;
+		} else if (WIFSIGNALED(p->ws)) {
+			printf("%s\tGot signal %d\n", job->cmd,
+			       WTERMSIG(p->ws));
+			code = 1;
+		} else
+			code = WEXITSTATUS(p->ws);
+		t->fail += code;
+		t->bad += code != 0;
+	}
+	free(job->cmd);
+	fflush(stdout);
 }
 
 /* Licenses: